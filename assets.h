@@ -0,0 +1,65 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Every asset packed into the binaries by mkassets, as X(ID, path). The
+// generated arrays follow the order of these lists.
+#define ASSETS_SPRITES(X) \
+	X(APPLE,           "gfx/apple.png") \
+	X(BODY_DOWN_LEFT,  "gfx/body_down_left.png") \
+	X(BODY_DOWN_RIGHT, "gfx/body_down_right.png") \
+	X(BODY_HORIZONTAL, "gfx/body_horizontal.png") \
+	X(BODY_UP_LEFT,    "gfx/body_up_left.png") \
+	X(BODY_UP_RIGHT,   "gfx/body_up_right.png") \
+	X(BODY_VERTICAL,   "gfx/body_vertical.png") \
+	X(HEAD_DOWN,       "gfx/head_down.png") \
+	X(HEAD_LEFT,       "gfx/head_left.png") \
+	X(HEAD_RIGHT,      "gfx/head_right.png") \
+	X(HEAD_UP,         "gfx/head_up.png") \
+	X(TAIL_DOWN,       "gfx/tail_down.png") \
+	X(TAIL_LEFT,       "gfx/tail_left.png") \
+	X(TAIL_RIGHT,      "gfx/tail_right.png") \
+	X(TAIL_UP,         "gfx/tail_up.png")
+
+#define ASSETS_SOUNDS(X) \
+	X(CHOMP, "sfx/chomp.wav") \
+	X(DEATH, "sfx/death.wav")
+
+// Sounds are stored as signed 16 bit samples in the byte order of the
+// machine that built them, at this rate and number of channels.
+#define ASSETS_SOUND_FREQUENCY 22050
+#define ASSETS_SOUND_CHANNELS 2
+
+// Pixels are stored as R, G, B and A bytes, row after row.
+struct asset_image
+{
+	int width, height;
+	const uint8_t *pixels;
+};
+
+struct asset_sound
+{
+	uint32_t size;
+	const uint8_t *samples;
+};
+
+extern const struct asset_image asset_sprites[];
+extern const struct asset_sound asset_sounds[];
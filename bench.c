@@ -0,0 +1,251 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "bench.h"
+#include "map.h"
+
+/* sizes of the generated maps benchmarked after the given ones */
+static const size_t generated_sizes[][2] = {
+	{ 256, 256 },
+	{ 1024, 1024 },
+	{ 4096, 4096 }
+};
+
+static const char *prog_name;
+static double min_time;
+
+void
+bench_die(const char *fmt, ...)
+{
+	va_list args;
+
+	fprintf(stderr, "%s: ", prog_name);
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fputc('\n', stderr);
+	exit(1);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: %s [-t min_seconds] [map_path...]\n", prog_name);
+	exit(1);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t
+cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/* walled map with a short snake heading right and one piece of food */
+static char *
+generate_map_str(size_t n_rows, size_t n_cols)
+{
+	size_t row, col;
+	char *map_str, *p;
+
+	if (NULL == (map_str = malloc(n_rows * (n_cols + 1) + 1)))
+		bench_die("out of memory");
+
+	for (p = map_str, row = 0; row < n_rows; ++row) {
+		for (col = 0; col < n_cols; ++col) {
+			if (row == 0 || col == 0 || row == n_rows - 1 ||
+					col == n_cols - 1)
+				*p++ = '=';
+			else if (row == n_rows / 2 && col >= 2 && col < 7)
+				*p++ = '>';
+			else if (row == n_rows / 2 && col == n_cols / 2)
+				*p++ = '*';
+			else
+				*p++ = ' ';
+		}
+		*p++ = '\n';
+	}
+
+	*p = '\0';
+
+	return map_str;
+}
+
+static void
+subject_init(struct subject *subject, const char *name, char *map_str)
+{
+	snprintf(subject->name, sizeof(subject->name), "%s", name);
+	subject->map_str = map_str;
+
+	if (NULL == (subject->origin = map_parse(map_str)))
+		bench_die("invalid map: %s", name);
+
+	if (NULL == (subject->map = map_create(subject->origin->n_rows,
+					subject->origin->n_cols)) ||
+			map_copy(subject->origin, subject->map) < 0 ||
+			NULL == (subject->str = malloc(MAP_STR_SIZE(subject->map))))
+		bench_die("out of memory");
+
+	map_journal_start(subject->map);
+}
+
+static void
+subject_load(struct subject *subject, const char *path)
+{
+	struct map *map;
+	char *map_str;
+
+	if (NULL == (map = map_parse_file(path)))
+		bench_die("invalid map: %s", path);
+
+	if (NULL == (map_str = malloc(MAP_STR_SIZE(map))))
+		bench_die("out of memory");
+
+	map_stringify(map, MAP_STR_SIZE(map), map_str);
+	map_destroy(map);
+	subject_init(subject, path, map_str);
+}
+
+static void
+subject_fini(struct subject *subject)
+{
+	map_destroy(subject->map);
+	map_destroy(subject->origin);
+	free(subject->map_str);
+	free(subject->str);
+}
+
+void
+bench_reset(struct subject *subject)
+{
+	if (map_rewind(subject->map, subject->origin) < 0)
+		bench_die("out of memory");
+}
+
+/* advances the game one tick, turning now and then and starting over on
+   death, as a game would */
+void
+bench_tick(struct subject *subject, uint64_t i)
+{
+	enum map_snake_state state;
+	struct map *map;
+
+	map = subject->map;
+
+	if (i % 16 == 0)
+		map_set_snake_direction(map, MAP_BLOCK_SNAKE_UP +
+				map_rng_bounded(&map->rng, 4));
+
+	if (map_advance(map, &state) < 0)
+		bench_die("out of memory");
+
+	if (state == MAP_SNAKE_DEAD ||
+			(state == MAP_SNAKE_EATING && map_spawn_food(map) < 0))
+		bench_reset(subject);
+}
+
+/* doubles the number of operations until a run lasts at least min_time */
+void
+bench_run(struct subject *subject, const char *name, bench_fn fn)
+{
+	uint64_t n, start_cycles, elapsed_cycles;
+	double start, elapsed;
+
+	for (n = 1;; n *= 2) {
+		start = now();
+		start_cycles = cycles();
+		fn(subject, n);
+		elapsed_cycles = cycles() - start_cycles;
+		elapsed = now() - start;
+		if (elapsed >= min_time)
+			break;
+	}
+
+	printf("%-22s %-24s %12.1f ns/op", subject->name, name, elapsed * 1e9 / n);
+	if (elapsed_cycles != 0)
+		printf(" %12.1f cycles/op", (double)(elapsed_cycles) / n);
+	putchar('\n');
+	fflush(stdout);
+}
+
+/* runs bench over the given maps, or the shipped ones, and then over the
+   generated ones */
+int
+bench_main(const char *prog, int argc, char **argv,
+		void (*bench)(struct subject *))
+{
+	static const char *default_paths[] = {
+		"maps/small", "maps/big", "maps/empty", NULL
+	};
+
+	struct subject subject;
+	const char **paths;
+	char name[64];
+	size_t i;
+	int opt;
+
+	prog_name = prog;
+	min_time = 0.25;
+
+	while ((opt = getopt(argc, argv, "t:")) != -1) {
+		switch (opt) {
+		case 't': min_time = strtod(optarg, NULL); break;
+		default: usage();
+		}
+	}
+
+	paths = optind < argc ? (const char **)(argv + optind) : default_paths;
+
+	for (; NULL != *paths; ++paths) {
+		subject_load(&subject, *paths);
+		bench(&subject);
+		subject_fini(&subject);
+	}
+
+	for (i = 0; i < sizeof(generated_sizes) / sizeof(generated_sizes[0]); ++i) {
+		snprintf(name, sizeof(name), "generated %zux%zu",
+				generated_sizes[i][0], generated_sizes[i][1]);
+		subject_init(&subject, name, generate_map_str(generated_sizes[i][0],
+					generated_sizes[i][1]));
+		bench(&subject);
+		subject_fini(&subject);
+	}
+
+	return 0;
+}
@@ -0,0 +1,41 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include "map.h"
+
+/* a map benchmarked from its text, with a copy to play on */
+struct subject {
+	char name[64];
+	char *map_str;
+	/* where map_stringify writes, apart from the map_str parsed */
+	char *str;
+	struct map *origin;
+	struct map *map;
+};
+
+typedef void (*bench_fn)(struct subject *, uint64_t);
+
+void bench_die(const char *fmt, ...);
+void bench_reset(struct subject *subject);
+void bench_tick(struct subject *subject, uint64_t i);
+void bench_run(struct subject *subject, const char *name, bench_fn fn);
+int bench_main(const char *prog, int argc, char **argv,
+		void (*bench)(struct subject *));
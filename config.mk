@@ -3,7 +3,9 @@
 
 CC=cc
 CFLAGS=-pedantic -Wall -Wextra -Os
-LDLIBS_NCURSES=-lcurses
-LDLIBS_SDL=-lSDL2 -lSDL2_image -lSDL2_mixer
-LDLIBS_XCB=-lxcb -lxcb-keysyms
+LDLIBS_NCURSES=-lcurses -lrt
+LDLIBS_SDL=-lSDL2 -lSDL2_mixer -lrt
+LDLIBS_MKASSETS=-lSDL2 -lSDL2_image
+LDLIBS_XCB=-lxcb -lxcb-keysyms -lxcb-shm -lrt
+LDLIBS_SIM=-lpthread
 LDFLAGS=-s
@@ -0,0 +1,163 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "export.h"
+#include "map.h"
+
+// Creates the shared memory segment called name, which readers open with
+// shm_open, and sizes it for the map. Nothing is exported when name is
+// NULL, and every other call then does nothing.
+int export_open(struct export *export, const char *name,
+		const struct map *map)
+{
+	struct export_header *header;
+	size_t size = EXPORT_SIZE(map->n_rows, map->n_cols);
+	int fd;
+
+	export->header = NULL;
+	export->name = name;
+	export->full = 1;
+
+	if (NULL == name)
+		return 0;
+
+	if ((fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0)
+		return -1;
+
+	if (ftruncate(fd, size) < 0 || MAP_FAILED == (header = mmap(NULL, size,
+					PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)))
+	{
+		close(fd);
+		shm_unlink(name);
+		return -1;
+	}
+
+	close(fd);
+
+	header->magic = EXPORT_MAGIC;
+	header->version = EXPORT_VERSION;
+	header->n_rows = map->n_rows;
+	header->n_cols = map->n_cols;
+	atomic_init(&header->seq, 0);
+
+	export->header = header;
+
+	return 0;
+}
+
+void export_close(struct export *export)
+{
+	if (NULL == export->header)
+		return;
+
+	munmap(export->header,
+			EXPORT_SIZE(export->header->n_rows, export->header->n_cols));
+	shm_unlink(export->name);
+	export->header = NULL;
+}
+
+// Writes the map into the segment. Only the blocks in the change log are
+// copied, so it has to be called before every map_clear_changes.
+void export_publish(struct export *export, const struct map *map,
+		uint32_t score)
+{
+	struct export_header *header = export->header;
+	const struct map_snake *snake;
+	uint32_t seq;
+	size_t n_exported_snakes;
+
+	if (NULL == header)
+		return;
+
+	// Seqlock: readers that see an odd or different sequence number try
+	// again, so the game never waits for them.
+	seq = atomic_load_explicit(&header->seq, memory_order_relaxed);
+	atomic_store_explicit(&header->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	header->score = score;
+	header->tick = map->tick;
+
+	n_exported_snakes = map->n_snakes < EXPORT_MAX_SNAKES ?
+		map->n_snakes : EXPORT_MAX_SNAKES;
+
+	for (size_t i = 0; i < n_exported_snakes; ++i)
+	{
+		snake = &map->snakes[i];
+		header->snakes[i].head_row = snake->head_row;
+		header->snakes[i].head_col = snake->head_col;
+		header->snakes[i].tail_row = snake->tail_row;
+		header->snakes[i].tail_col = snake->tail_col;
+		header->snakes[i].length = snake->body_len;
+		header->snakes[i].state = snake->state;
+	}
+
+	header->n_snakes = map->n_snakes;
+	header->n_exported_snakes = n_exported_snakes;
+
+	if (export->full || map->all_changed)
+	{
+		memcpy(header->blocks, map->blocks,
+				(map->n_rows * map->n_cols + 1) / 2);
+		export->full = 0;
+	}
+	else
+	{
+		// The byte holding a block holds its neighbour as well, which
+		// is up to date in the map all the same.
+		for (size_t i = 0; i < map->n_changes; ++i)
+			header->blocks[map->changes[i] / 2] =
+				map->blocks[map->changes[i] / 2];
+	}
+
+	atomic_store_explicit(&header->seq, seq + 2, memory_order_release);
+}
+
+// Copies a consistent snapshot of a segment mapped by a reader. The copy
+// must be EXPORT_SIZE bytes long for the size of the map. Fails when no
+// consistent snapshot was seen after EXPORT_MAX_READ_TRIES tries.
+int export_read(const struct export_header *header,
+		struct export_header *copy)
+{
+	size_t size = EXPORT_SIZE(header->n_rows, header->n_cols);
+	uint32_t seq;
+
+	for (size_t tries = 0; tries < EXPORT_MAX_READ_TRIES; ++tries)
+	{
+		if ((seq = atomic_load_explicit(&header->seq,
+						memory_order_acquire)) & 1)
+			continue;
+
+		memcpy(copy, header, size);
+		atomic_thread_fence(memory_order_acquire);
+
+		if (seq == atomic_load_explicit(&header->seq, memory_order_relaxed))
+		{
+			atomic_init(&copy->seq, seq);
+			return 0;
+		}
+	}
+
+	return -1;
+}
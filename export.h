@@ -0,0 +1,86 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "map.h"
+
+#define EXPORT_MAGIC 0x54524256
+#define EXPORT_VERSION 2
+
+// Snakes past this many are left out of the export.
+#define EXPORT_MAX_SNAKES 16
+
+// Number of times export_read looks at the sequence number before giving
+// up on a game that does not finish a publish, e.g. one killed midway.
+#define EXPORT_MAX_READ_TRIES 1000000
+
+// Size of the shared memory segment of a map.
+#define EXPORT_SIZE(n_rows, n_cols) \
+	(offsetof(struct export_header, blocks) + ((n_rows) * (n_cols) + 1) / 2)
+
+struct export_snake
+{
+	uint32_t head_row, head_col;
+	uint32_t tail_row, tail_col;
+	uint32_t length;
+	// An enum map_snake_state.
+	uint32_t state;
+};
+
+// Layout of the shared memory segment, made only of fixed size fields so
+// that readers need not be built along with the game.
+struct export_header
+{
+	uint32_t magic, version;
+	// Odd while the game is writing. Readers copy what they need and
+	// start over if it was odd or changed in the meantime.
+	_Atomic uint32_t seq;
+	uint32_t n_rows, n_cols;
+	uint32_t score;
+	uint64_t tick;
+	// Number of snakes on the map, and of those in snakes, which are the
+	// first EXPORT_MAX_SNAKES of them.
+	uint32_t n_snakes, n_exported_snakes;
+	struct export_snake snakes[EXPORT_MAX_SNAKES];
+	// Packed as in struct map, two blocks per byte, the first one in the
+	// low nibble.
+	uint8_t blocks[];
+};
+
+// Publishes the state of a map to other processes, which read it without
+// the game ever waiting on them.
+struct export
+{
+	// NULL when nothing is exported.
+	struct export_header *header;
+	const char *name;
+	// The next publish copies every block instead of the changed ones.
+	int full;
+};
+
+int export_open(struct export *export, const char *name,
+		const struct map *map);
+void export_close(struct export *export);
+void export_publish(struct export *export, const struct map *map,
+		uint32_t score);
+int export_read(const struct export_header *header,
+		struct export_header *copy);
@@ -0,0 +1,73 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#include <stdlib.h>
+#include "map.h"
+#include "level.h"
+
+struct level *level_load(const char *path)
+{
+	struct level *level;
+
+	if (NULL == (level = malloc(sizeof(struct level))))
+		return NULL;
+
+	if (NULL == (level->origin = map_parse_file(path)))
+	{
+		free(level);
+		return NULL;
+	}
+
+	return level;
+}
+
+void level_destroy(struct level *level)
+{
+	if (NULL == level)
+		return;
+	map_destroy(level->origin);
+	free(level);
+}
+
+// Creates a map with the initial state of the level, journaling its
+// writes so that level_reset only has to undo the blocks that changed.
+struct map *level_new_map(const struct level *level)
+{
+	struct map *map;
+
+	if (NULL == (map = map_create(level->origin->n_rows,
+					level->origin->n_cols)))
+		return NULL;
+
+	if (map_copy(level->origin, map) < 0)
+	{
+		map_destroy(map);
+		return NULL;
+	}
+
+	map_journal_start(map);
+
+	return map;
+}
+
+// Takes a map created by level_new_map back to the initial state of the
+// level. The food generator of the map is left as it is.
+int level_reset(const struct level *level, struct map *map)
+{
+	return map_rewind(map, level->origin);
+}
@@ -0,0 +1,33 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#pragma once
+
+#include "map.h"
+
+// A level keeps the map as it was loaded, so that a map can be taken
+// back to it when a game ends without reading or parsing the file again.
+struct level
+{
+	struct map *origin;
+};
+
+struct level *level_load(const char *path);
+void level_destroy(struct level *level);
+struct map *level_new_map(const struct level *level);
+int level_reset(const struct level *level, struct map *map);
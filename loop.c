@@ -0,0 +1,183 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include "loop.h"
+
+#define NSEC_PER_SEC 1000000000
+
+static void __loop_timespec(int64_t ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / NSEC_PER_SEC;
+	ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+// Makes the timer, if there is one, expire at every deadline, or never
+// while the loop is paused.
+static int __loop_arm_timer(const struct loop *loop)
+{
+	struct itimerspec its = { 0 };
+
+	if (loop->timer_fd < 0)
+		return 0;
+
+	if (!loop->paused)
+	{
+		__loop_timespec(loop->deadline, &its.it_value);
+		__loop_timespec(loop->period, &its.it_interval);
+	}
+
+	return timerfd_settime(loop->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+// Current time on the monotonic clock, in nanoseconds.
+int64_t loop_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)(ts.tv_sec) * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+// Starts a loop that ticks every period nanoseconds, the first tick
+// being due right away.
+void loop_init(struct loop *loop, int64_t period)
+{
+	loop->period = period;
+	loop->deadline = loop_now();
+	loop->jitter_last = loop->jitter_max = loop->jitter_total = 0;
+	loop->n_wakeups = loop->n_ticks = 0;
+	loop->timer_fd = -1;
+	loop->paused = 0;
+}
+
+// Creates a timer that becomes readable whenever a tick is due, for
+// loops that wait in poll along with other file descriptors. Returns
+// its file descriptor, or -1 on error.
+int loop_open_timer(struct loop *loop)
+{
+	if ((loop->timer_fd = timerfd_create(CLOCK_MONOTONIC,
+					TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+		return -1;
+
+	if (__loop_arm_timer(loop) < 0)
+	{
+		loop_close_timer(loop);
+		return -1;
+	}
+
+	return loop->timer_fd;
+}
+
+void loop_close_timer(struct loop *loop)
+{
+	if (loop->timer_fd >= 0)
+		close(loop->timer_fd);
+	loop->timer_fd = -1;
+}
+
+// Stops the ticks, and the timer with them, until loop_resume.
+void loop_pause(struct loop *loop)
+{
+	if (loop->paused)
+		return;
+	loop->paused = 1;
+	__loop_arm_timer(loop);
+}
+
+// Starts ticking again, the first tick being due right away.
+void loop_resume(struct loop *loop)
+{
+	if (!loop->paused)
+		return;
+	loop->paused = 0;
+	loop->deadline = loop_now();
+	__loop_arm_timer(loop);
+}
+
+// Returns how many ticks are due and moves the deadline past them. The
+// deadlines stay a multiple of the period apart, so a late tick does not
+// delay the ones after it.
+int loop_ticks(struct loop *loop)
+{
+	uint64_t expirations;
+	int64_t now;
+	int n;
+
+	if (loop->paused)
+		return 0;
+
+	// The timer is only drained so that poll stops reporting it, the
+	// clock is what tells how many ticks are due. It fails with EAGAIN
+	// when the timer did not expire since the last call.
+	if (loop->timer_fd >= 0 &&
+			read(loop->timer_fd, &expirations, sizeof(expirations)) < 0)
+		expirations = 0;
+
+	now = loop_now();
+
+	if (now < loop->deadline)
+		return 0;
+
+	loop->jitter_last = now - loop->deadline;
+	loop->jitter_total += loop->jitter_last;
+	loop->n_wakeups += 1;
+	if (loop->jitter_last > loop->jitter_max)
+		loop->jitter_max = loop->jitter_last;
+
+	n = 1 + (now - loop->deadline) / loop->period;
+
+	// After a long stall, such as the process being stopped, start over
+	// from now instead of running every missed tick at once.
+	if (n > LOOP_MAX_CATCH_UP)
+	{
+		loop->deadline = now + loop->period;
+		n = LOOP_MAX_CATCH_UP;
+		__loop_arm_timer(loop);
+	}
+	else
+	{
+		loop->deadline += n * loop->period;
+	}
+
+	loop->n_ticks += n;
+
+	return n;
+}
+
+// Sleeps until the next tick is due.
+void loop_wait(const struct loop *loop)
+{
+	struct timespec ts;
+
+	__loop_timespec(loop->deadline, &ts);
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+}
+
+// Mean lateness of the wakeups after their deadline, in nanoseconds.
+int64_t loop_jitter_mean(const struct loop *loop)
+{
+	if (loop->n_wakeups == 0)
+		return 0;
+	return loop->jitter_total / (int64_t)(loop->n_wakeups);
+}
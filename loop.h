@@ -0,0 +1,49 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Ticks due at once after the loop fell behind, the rest are dropped.
+#define LOOP_MAX_CATCH_UP 4
+
+// Runs the game at a fixed rate, measured on the monotonic clock, no
+// matter how long each frame takes to draw.
+struct loop
+{
+	int64_t period;
+	// Time at which the next tick is due, in nanoseconds.
+	int64_t deadline;
+	// How late the loop woke up after a deadline, in nanoseconds.
+	int64_t jitter_last, jitter_max, jitter_total;
+	uint64_t n_wakeups, n_ticks;
+	// Optional timer expiring at every deadline, -1 when there is none.
+	int timer_fd;
+	int paused;
+};
+
+int64_t loop_now(void);
+void loop_init(struct loop *loop, int64_t period);
+int loop_open_timer(struct loop *loop);
+void loop_close_timer(struct loop *loop);
+void loop_pause(struct loop *loop);
+void loop_resume(struct loop *loop);
+int loop_ticks(struct loop *loop);
+void loop_wait(const struct loop *loop);
+int64_t loop_jitter_mean(const struct loop *loop);
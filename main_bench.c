@@ -0,0 +1,94 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#include <stdint.h>
+#include "bench.h"
+#include "map.h"
+
+static void
+bench_parse(struct subject *subject, uint64_t n)
+{
+	while (n--)
+		map_destroy(map_parse(subject->map_str));
+}
+
+static void
+bench_stringify(struct subject *subject, uint64_t n)
+{
+	while (n--)
+		map_stringify(subject->map, MAP_STR_SIZE(subject->map),
+				subject->str);
+}
+
+static void
+bench_advance(struct subject *subject, uint64_t n)
+{
+	uint64_t i;
+
+	for (i = 0; i < n; ++i)
+		bench_tick(subject, i);
+
+	bench_reset(subject);
+}
+
+static void
+bench_set_direction(struct subject *subject, uint64_t n)
+{
+	while (n--)
+		map_set_snake_direction(subject->map, MAP_BLOCK_SNAKE_UP + n % 4);
+}
+
+/* starts over once half of the free blocks have been taken */
+static void
+bench_spawn_food(struct subject *subject, uint64_t n)
+{
+	while (n--)
+		if (map_spawn_food(subject->map) < 0 ||
+				subject->map->n_free_blocks <
+				subject->origin->n_free_blocks / 2)
+			bench_reset(subject);
+
+	bench_reset(subject);
+}
+
+static void
+bench_copy(struct subject *subject, uint64_t n)
+{
+	while (n--)
+		if (map_copy(subject->origin, subject->map) < 0)
+			bench_die("out of memory");
+
+	map_journal_start(subject->map);
+}
+
+static void
+bench(struct subject *subject)
+{
+	bench_run(subject, "map_parse", bench_parse);
+	bench_run(subject, "map_stringify", bench_stringify);
+	bench_run(subject, "map_advance", bench_advance);
+	bench_run(subject, "map_set_snake_direction", bench_set_direction);
+	bench_run(subject, "map_spawn_food", bench_spawn_food);
+	bench_run(subject, "map_copy", bench_copy);
+}
+
+int
+main(int argc, char **argv)
+{
+	return bench_main("viborita_bench", argc, argv, bench);
+}
@@ -0,0 +1,98 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ncurses.h>
+#include "bench.h"
+#include "map.h"
+#include "render_ncurses.h"
+
+/* size of the offscreen terminal, in cells */
+#define BENCH_LINES 50
+#define BENCH_COLS 160
+
+static struct screen screen;
+
+/* moves the snake and draws the cells that changed, as every frame of
+   viborita_ncurses does */
+static void
+bench_draw_tick(struct subject *subject, uint64_t n)
+{
+	uint64_t i;
+
+	for (i = 0; i < n; ++i) {
+		bench_tick(subject, i);
+		if (draw_map(&screen, subject->map, false) < 0)
+			bench_die("out of memory");
+		refresh();
+	}
+
+	bench_reset(subject);
+}
+
+/* checks every cell of the terminal, as after a pause or a resize */
+static void
+bench_draw_full(struct subject *subject, uint64_t n)
+{
+	while (n--) {
+		screen.full = true;
+		if (draw_map(&screen, subject->map, false) < 0)
+			bench_die("out of memory");
+		refresh();
+	}
+}
+
+static void
+bench(struct subject *subject)
+{
+	screen.camera_row = subject->map->snakes[0].head_row;
+	screen.camera_col = subject->map->snakes[0].head_col;
+	screen.full = true;
+	bench_run(subject, "draw_map", bench_draw_tick);
+	bench_run(subject, "draw_map full", bench_draw_full);
+}
+
+int
+main(int argc, char **argv)
+{
+	FILE *out, *in;
+	int ret;
+
+	/* curses writes the frames to /dev/null, as it would to a terminal
+	   of the type in $TERM */
+	if (NULL == (out = fopen("/dev/null", "w")) ||
+			NULL == (in = fopen("/dev/null", "r")) ||
+			NULL == newterm(NULL, out, in)) {
+		fputs("viborita_bench_ncurses: can't open a terminal on /dev/null,"
+				" is $TERM set?\n", stderr);
+		return 1;
+	}
+
+	resizeterm(BENCH_LINES, BENCH_COLS);
+	init_colors();
+
+	ret = bench_main("viborita_bench_ncurses", argc, argv, bench);
+
+	endwin();
+	free(screen.cells);
+
+	return ret;
+}
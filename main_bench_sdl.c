@@ -0,0 +1,96 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <SDL2/SDL.h>
+#include "bench.h"
+#include "map.h"
+#include "render_sdl.h"
+
+/* size of the offscreen surface, the same as the window of viborita_sdl */
+#define BENCH_WIDTH 640
+#define BENCH_HEIGHT 480
+
+/* size of a block in pixels, as in viborita_sdl */
+#define BENCH_BLOCK_SIZE 40
+
+static struct sdl_context ctx;
+
+/* moves the snake and draws a whole frame, as every frame of viborita_sdl
+   does */
+static void
+bench_render_map(struct subject *subject, uint64_t n)
+{
+	uint64_t i;
+
+	for (i = 0; i < n; ++i) {
+		bench_tick(subject, i);
+		begin_draw(&ctx);
+		render_map(&ctx, subject->map, BENCH_BLOCK_SIZE);
+		end_draw(&ctx);
+	}
+
+	bench_reset(subject);
+}
+
+static void
+bench_build_static_layer(struct subject *subject, uint64_t n)
+{
+	while (n--)
+		build_static_layer(&ctx, subject->map);
+}
+
+static void
+bench(struct subject *subject)
+{
+	bench_run(subject, "build_static_layer", bench_build_static_layer);
+	bench_run(subject, "render_map", bench_render_map);
+}
+
+int
+main(int argc, char **argv)
+{
+	SDL_Surface *surface;
+	int ret;
+
+	/* the software renderer draws into a surface in memory, with no
+	   window nor video driver */
+	if (NULL == (surface = SDL_CreateRGBSurfaceWithFormat(0, BENCH_WIDTH,
+					BENCH_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888)) ||
+			NULL == (ctx.renderer = SDL_CreateSoftwareRenderer(surface))) {
+		fprintf(stderr, "viborita_bench_sdl: can't create renderer: %s\n",
+				SDL_GetError());
+		return 1;
+	}
+
+	build_atlas(&ctx);
+
+	ret = bench_main("viborita_bench_sdl", argc, argv, bench);
+
+	SDL_DestroyTexture(ctx.atlas);
+	if (NULL != ctx.static_layer)
+		SDL_DestroyTexture(ctx.static_layer);
+	free(ctx.vertices);
+	free(ctx.indices);
+	SDL_DestroyRenderer(ctx.renderer);
+	SDL_FreeSurface(surface);
+
+	return ret;
+}
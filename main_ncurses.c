@@ -17,98 +17,296 @@
 */
 
 #include "map.h"
+#include "level.h"
+#include "replay.h"
+#include "view.h"
+#include "loop.h"
+#include "export.h"
+#include "render_ncurses.h"
+#include <errno.h>
+#include <poll.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <ncurses.h>
 #include <stdbool.h>
 
-#define PAUSE_MSG "paused"
+// Time between two steps of the snake, in nanoseconds.
+#define TICK_PERIOD 100000000
+
+// The timer only runs along with the game, so a paused game sleeps in
+// poll until a key is pressed.
+static void sync_timer(struct loop *loop, bool paused)
+{
+	if (paused)
+		loop_pause(loop);
+	else
+		loop_resume(loop);
+}
+
+// Loads the next game of a replay being played back onto the map, which
+// must be the size of the games. Returns 0 at the end of the replay.
+static int next_game(FILE *fp, struct replay_game *game, struct map *map)
+{
+	int ret;
+
+	replay_free_game(game);
+
+	if ((ret = replay_read_game(fp, game)) <= 0)
+		return ret;
+
+	if (game->map->n_rows != map->n_rows ||
+			game->map->n_cols != map->n_cols ||
+			replay_start(game, map) < 0)
+		return -1;
+
+	return 1;
+}
 
 int
 main(int argc, char **argv)
 {
 	int score = 0, hi_score = 0;
-	struct map map, o_map;
+	struct level *level;
+	struct map *map;
 	enum map_snake_state state;
 	enum map_block_type dir;
-	char map_str[MAX_MAP_STR_LEN+1];
+	struct replay replay;
+	FILE *replay_fp = NULL;
+	struct replay_game game = { 0 };
+	FILE *play_fp = NULL;
+	size_t turn = 0;
+	int play_ret = 1;
+	struct screen screen = { NULL, 0, 0, 0, 0, true };
+	struct loop loop;
+	struct export export;
+	const char *export_name = NULL;
+	struct pollfd fds[2];
+	int ticks;
 	bool paused = false;
 	bool should_close = false;
+	bool redraw = true;
 	int c;
 
-	if (argc < 2 || map_parse_file(&map, argv[1]) < 0)
+	while ((c = getopt(argc, argv, "e:r:")) != -1)
+	{
+		switch (c)
+		{
+			case 'e': export_name = optarg; break;
+			case 'r': play_fp = fopen(optarg, "rb"); break;
+			default: goto usage;
+		}
+
+		if (c == 'r' && NULL == play_fp)
+			goto usage;
+	}
+
+	if (NULL != play_fp)
+	{
+		// Playing back a replay, which holds the maps of its games.
+		level = NULL;
+
+		if (optind != argc || replay_read_game(play_fp, &game) <= 0)
+			goto usage;
+
+		if (NULL == (map = map_create(game.map->n_rows,
+						game.map->n_cols)) ||
+				replay_start(&game, map) < 0)
+		{
+			fprintf(stderr, "viborita_ncurses: out of memory\n");
+			return 1;
+		}
+	}
+	else
+	{
+		if (optind == argc ||
+				NULL == (level = level_load(argv[optind])) ||
+				(argc - optind > 1 &&
+				 NULL == (replay_fp = fopen(argv[optind + 1], "wb"))))
+			goto usage;
+
+		if (NULL == (map = level_new_map(level)))
+		{
+			fprintf(stderr, "viborita_ncurses: out of memory\n");
+			return 1;
+		}
+
+		// Seed the food generator with the current process id.
+		map_seed(map, getpid());
+	}
+
+	if (export_open(&export, export_name, map) < 0)
 	{
-		fprintf(stderr, "usage: viborita_ncurses [valid_map_path]\n");
+		fprintf(stderr, "viborita_ncurses: can't export to %s\n",
+				export_name);
 		return 1;
 	}
 
+	loop_init(&loop, TICK_PERIOD);
+
+	fds[0].fd = STDIN_FILENO;
+	fds[0].events = POLLIN;
+	fds[1].fd = loop_open_timer(&loop);
+	fds[1].events = POLLIN;
+
+	if (fds[1].fd < 0)
+	{
+		fprintf(stderr, "viborita_ncurses: can't create timer\n");
+		return 1;
+	}
+
+	replay_begin(&replay, replay_fp, map);
+
 	initscr();
 	nodelay(stdscr, TRUE);
 	curs_set(0);
 	noecho();
-	map_copy(&map, &o_map);
+	init_colors();
+
+	screen.camera_row = map->snakes[0].head_row;
+	screen.camera_col = map->snakes[0].head_col;
 
 	while (!should_close)
 	{
-		dir = MAP_BLOCK_INVALID;
-
-		while ((c = getch()) != ERR) switch (c)
+		if (redraw)
 		{
-			case 'h': dir = MAP_BLOCK_SNAKE_LEFT; break;
-			case 'j': dir = MAP_BLOCK_SNAKE_DOWN; break;
-			case 'k': dir = MAP_BLOCK_SNAKE_UP; break;
-			case 'l': dir = MAP_BLOCK_SNAKE_RIGHT; break;
-			case 'p': paused = !paused; break;
-			case 'q': should_close = true; break;
+			// Drawing clears the change log the export copies from.
+			export_publish(&export, map, score);
+
+			if (draw_map(&screen, map, paused) < 0)
+				break;
+
+			mvprintw(LINES - 2, 0, "Highest score: %d", hi_score);
+			clrtoeol();
+			mvprintw(LINES - 1, 0, "Score: %d", score);
+			clrtoeol();
+
+			refresh();
+			redraw = false;
 		}
 
-		if (dir != MAP_BLOCK_INVALID)
+		sync_timer(&loop, paused);
+
+		// Wakes up on a key, a tick or a resize, which interrupts it.
+		if (poll(fds, 2, -1) < 0 && errno != EINTR)
+			break;
+
+		// Every key is queued, so turns typed faster than the snake
+		// moves are taken one per tick instead of only the last one.
+		while ((c = getch()) != ERR)
 		{
+			switch (c)
+			{
+				case 'h': dir = MAP_BLOCK_SNAKE_LEFT; break;
+				case 'j': dir = MAP_BLOCK_SNAKE_DOWN; break;
+				case 'k': dir = MAP_BLOCK_SNAKE_UP; break;
+				case 'l': dir = MAP_BLOCK_SNAKE_RIGHT; break;
+				case 'p':
+					paused = !paused;
+					redraw = screen.full = true;
+					continue;
+				case 'q': should_close = true; continue;
+				case KEY_RESIZE: redraw = true; continue;
+				default: continue;
+			}
+
+			// Turns come from the replay when playing one back.
+			if (NULL != play_fp)
+				continue;
+
+			if (paused)
+				redraw = screen.full = true;
 			paused = false;
-			map_set_snake_direction(&map, dir);
+			map_queue_direction(map, dir, loop_now());
 		}
 
-		if (!paused)
+		sync_timer(&loop, paused);
+
+		for (ticks = loop_ticks(&loop); ticks > 0 && !paused; --ticks)
 		{
-			map_advance(&map, &state);
+			redraw = true;
+
+			if (NULL == play_fp)
+			{
+				map_advance(map, &state);
+				replay_turn(&replay, map);
+			}
+			else if ((play_ret = replay_step(&game, map, &turn,
+							&state)) == 0)
+			{
+				// Go on with the next game once one is over.
+				if ((play_ret = next_game(play_fp, &game, map)) <= 0)
+				{
+					should_close = true;
+					break;
+				}
+				turn = 0;
+				score = 0;
+				continue;
+			}
+			else if (play_ret < 0)
+			{
+				should_close = true;
+				break;
+			}
 
 			switch (state)
 			{
 				case MAP_SNAKE_EATING:
-					map_spawn_food(&map);
+					map_spawn_food(map);
 					score += 1;
 					if (score > hi_score)
 						hi_score = score;
 					break;
 				case MAP_SNAKE_DEAD:
-					map_copy(&o_map, &map);
 					score = 0;
+					// A replay goes on with its next game on the
+					// next tick.
+					if (NULL != play_fp)
+						break;
+					replay_end(&replay, map);
+					level_reset(level, map);
+					replay_begin(&replay, replay_fp, map);
+					break;
+				case MAP_SNAKE_IDLE:
 					break;
 			}
 		}
+	}
 
-		map_stringify(&map, sizeof(map_str), map_str);
-		move(0, 0);
-		printw(map_str);
+	endwin();
+	loop_close_timer(&loop);
+	export_close(&export);
+	free(screen.cells);
+	printf("Highest score: %d\n", hi_score);
+	printf("Tick jitter: mean %.3fms, max %.3fms\n",
+			loop_jitter_mean(&loop) / 1e6, loop.jitter_max / 1e6);
 
-		if (paused)
-		{
-			move(map.n_rows/2, (map.n_cols-sizeof(PAUSE_MSG))/2);
-			printw(PAUSE_MSG);
-		}
+	if (NULL != replay_fp)
+	{
+		replay_end(&replay, map);
+		fclose(replay_fp);
+	}
 
-		move(map.n_rows, 0);
-		printw("Highest score: %d", hi_score);
-		move(map.n_rows + 1, 0);
-		printw("Score: %d", score);
+	if (NULL != play_fp)
+	{
+		replay_free_game(&game);
+		fclose(play_fp);
+	}
 
-		refresh();
+	map_destroy(map);
+	level_destroy(level);
 
-		usleep(100000);
+	if (play_ret < 0)
+	{
+		fprintf(stderr, "viborita_ncurses: invalid replay\n");
+		return 1;
 	}
 
-	endwin();
-	printf("Highest score: %d\n", hi_score);
-
 	return 0;
+
+usage:
+	fprintf(stderr, "usage: viborita_ncurses [-e shm_name]"
+			" [-r replay_path | valid_map_path [replay_path]]\n");
+	return 1;
 }
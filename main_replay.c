@@ -0,0 +1,109 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "map.h"
+#include "replay.h"
+
+static void
+die(const char *fmt, ...)
+{
+	va_list args;
+
+	fputs("viborita_replay: ", stderr);
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fputc('\n', stderr);
+	exit(1);
+}
+
+static void
+usage(void)
+{
+	fputs("usage: viborita_replay replay_path\n", stderr);
+	exit(1);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct replay_game game;
+	struct map *map;
+	FILE *fp;
+	uint64_t ticks;
+	size_t n_games, n_bad;
+	double start, elapsed;
+	int ret;
+
+	if (argc != 2)
+		usage();
+
+	if (NULL == (fp = fopen(argv[1], "rb")))
+		die("can't open %s", argv[1]);
+
+	map = NULL;
+	ticks = n_games = n_bad = 0;
+	elapsed = 0;
+
+	while ((ret = replay_read_game(fp, &game)) > 0) {
+		if (NULL == map || map->n_rows != game.map->n_rows ||
+				map->n_cols != game.map->n_cols) {
+			map_destroy(map);
+			if (NULL == (map = map_create(game.map->n_rows,
+							game.map->n_cols)))
+				die("out of memory");
+		}
+
+		start = now();
+		if (replay_run(&game, map) < 0) {
+			printf("game %zu: diverged at tick %llu\n", n_games,
+					(unsigned long long)(map->tick));
+			n_bad += 1;
+		}
+		elapsed += now() - start;
+
+		ticks += map->tick;
+		n_games += 1;
+		replay_free_game(&game);
+	}
+
+	if (ret < 0)
+		die("invalid replay: %s", argv[1]);
+
+	printf("games: %zu  diverged: %zu  ticks: %llu  ticks/sec: %.0f\n",
+			n_games, n_bad, (unsigned long long)(ticks),
+			elapsed > 0 ? ticks / elapsed : 0);
+
+	fclose(fp);
+	map_destroy(map);
+
+	return n_bad > 0;
+}
@@ -17,31 +17,59 @@
 */
 
 #include "map.h"
+#include "level.h"
+#include "replay.h"
+#include "view.h"
+#include "loop.h"
+#include "export.h"
+#include "assets.h"
+#include "render_sdl.h"
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
 #include <SDL2/SDL_render.h>
 #include <SDL2/SDL_mixer.h>
 #include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
 
-#define MAX_TEXTURES 32
-#define MAX_SOUNDS 8
+// Time between two steps of the snake, in nanoseconds.
+#define TICK_PERIOD 80000000
 
-struct sdl_context
+// Hand the embedded sounds to the mixer, indexed by their id.
+void load_sounds(struct sdl_context *ctx)
 {
-	SDL_Window *win;
-	SDL_Renderer *renderer;
-	int n_textures;
-	const char *textures_paths[MAX_TEXTURES];
-	SDL_Texture *textures[MAX_TEXTURES];
-	int n_sounds;
-	const char *sounds_paths[MAX_SOUNDS];
-	Mix_Chunk *sounds[MAX_SOUNDS];
-};
-
-void fail(const char *msg)
-{
-	fputs(msg, stderr);
-	exit(1);
+	SDL_AudioCVT cvt;
+	Uint16 format;
+	int frequency, channels;
+
+	if (0 == Mix_QuerySpec(&frequency, &format, &channels))
+		fail("couldn't query audio device");
+
+	for (int i = 0; i < SOUND_COUNT; ++i)
+	{
+		ctx->converted[i] = NULL;
+
+		if (SDL_BuildAudioCVT(&cvt, AUDIO_S16SYS, ASSETS_SOUND_CHANNELS,
+					ASSETS_SOUND_FREQUENCY, format, channels, frequency) < 0)
+			fail("couldn't convert sound");
+
+		if (cvt.needed)
+		{
+			cvt.len = asset_sounds[i].size;
+			if (NULL == (cvt.buf = malloc(cvt.len * cvt.len_mult)))
+				fail("out of memory");
+			memcpy(cvt.buf, asset_sounds[i].samples, cvt.len);
+			if (SDL_ConvertAudio(&cvt) < 0)
+				fail("couldn't convert sound");
+			ctx->converted[i] = cvt.buf;
+		}
+
+		// The chunks point at the samples, which outlive the mixer.
+		if (NULL == (ctx->sounds[i] = cvt.needed ?
+					Mix_QuickLoad_RAW(cvt.buf, cvt.len_cvt) :
+					Mix_QuickLoad_RAW((Uint8 *)(asset_sounds[i].samples),
+						asset_sounds[i].size)))
+			fail("couldn't load sound");
+	}
 }
 
 // Setup SDL subsystems and create a window & a renderer.
@@ -50,14 +78,14 @@ void init_context(struct sdl_context *ctx)
 	if (SDL_Init(SDL_INIT_VIDEO|SDL_INIT_AUDIO) < 0)
 		fail("couldn't init sdl_video & sdl_audio");
 
-	if (IMG_Init(IMG_INIT_PNG) < 0)
-		fail("couldn't init sdl_image");
-
-	if (Mix_OpenAudio(22050, MIX_DEFAULT_FORMAT, 2, 1024) == -1)
+	if (Mix_OpenAudio(ASSETS_SOUND_FREQUENCY, AUDIO_S16SYS,
+				ASSETS_SOUND_CHANNELS, 1024) == -1)
 		fail("couldn't open audio device");
 
-	ctx->n_sounds = 0;
-	ctx->n_textures = 0;
+	ctx->vertices = NULL;
+	ctx->indices = NULL;
+	ctx->n_quads = ctx->max_quads = 0;
+	ctx->static_layer = NULL;
 
 	ctx->win = SDL_CreateWindow(
 		"viborita",
@@ -70,332 +98,142 @@ void init_context(struct sdl_context *ctx)
 	ctx->renderer = SDL_CreateRenderer(
 		ctx->win,
 		-1,
-		SDL_RENDERER_ACCELERATED |
-			SDL_RENDERER_PRESENTVSYNC
+		SDL_RENDERER_ACCELERATED
 	);
+
+	// Every asset is built into the binary, so nothing is read from the
+	// disk and the game runs from any directory.
+	build_atlas(ctx);
+	load_sounds(ctx);
 }
 
 // Release previously allocated sdl resources.
 void fini_context(struct sdl_context *ctx)
 {
-	for (size_t i = 0; i < ctx->n_textures; ++i)
-		SDL_DestroyTexture(ctx->textures[i]);
+	SDL_DestroyTexture(ctx->atlas);
+	if (NULL != ctx->static_layer)
+		SDL_DestroyTexture(ctx->static_layer);
+	free(ctx->vertices);
+	free(ctx->indices);
 
-	for (size_t i = 0; i < ctx->n_sounds; ++i)
+	for (int i = 0; i < SOUND_COUNT; ++i)
 		Mix_FreeChunk(ctx->sounds[i]);
 
+	Mix_CloseAudio();
+
+	for (int i = 0; i < SOUND_COUNT; ++i)
+		free(ctx->converted[i]);
+
 	SDL_DestroyRenderer(ctx->renderer);
 	SDL_DestroyWindow(ctx->win);
 
-	IMG_Quit();
 	SDL_Quit();
 }
 
-// Load a texture and return an id that identifies that texture.
-int load_texture(struct sdl_context *ctx, const char *texture_path)
-{
-	for (size_t i = 0; i < ctx->n_textures; ++i)
-		if (strcmp(ctx->textures_paths[i], texture_path) == 0)
-			return i;
-
-	if (ctx->n_textures == MAX_TEXTURES)
-		fail("max textures limit reached");
-
-	ctx->textures_paths[ctx->n_textures] = texture_path;
-	ctx->textures[ctx->n_textures] = IMG_LoadTexture(ctx->renderer,
-			texture_path);
-	ctx->n_textures += 1;
-
-	return ctx->n_textures - 1;
-}
-
-// Load a sound and return an id that identifies that sound.
-int load_sound(struct sdl_context *ctx, const char *sound_path)
-{
-	for (size_t i = 0; i < ctx->n_sounds; ++i)
-		if (strcmp(ctx->sounds_paths[i], sound_path) == 0)
-			return i;
-
-	if (ctx->n_sounds == MAX_SOUNDS)
-		fail("max sounds limit reached");
-
-	ctx->sounds_paths[ctx->n_sounds] = sound_path;
-	ctx->sounds[ctx->n_sounds] = Mix_LoadWAV(sound_path);
-	ctx->n_sounds += 1;
-
-	return ctx->n_sounds - 1;
-}
-
-void play_sound(const struct sdl_context *ctx, int id)
+void play_sound(const struct sdl_context *ctx, enum sound id)
 {
-	if (id >= ctx->n_sounds || id < 0)
-		fail("unknown sound id");
-
 	Mix_PlayChannel(-1, ctx->sounds[id], 0);
 }
 
-void render_texture(const struct sdl_context *ctx, int id, int x, int y,
-		int w, int h)
+// Loads the next game of a replay being played back onto the map, which
+// must be the size of the games. Returns 0 at the end of the replay.
+static int next_game(FILE *fp, struct replay_game *game, struct map *map)
 {
-	if (id >= ctx->n_textures || id < 0)
-		fail("unknown texture id");
-
-	SDL_Rect rect = {
-		.x = x,
-		.y = y,
-		.w = w,
-		.h = h
-	};
-
-	SDL_RenderCopy(
-		ctx->renderer,
-		ctx->textures[id],
-		NULL,
-		&rect
-	);
-}
+	int ret;
 
-void render_rect(const struct sdl_context *ctx, int x, int y, int w, int h,
-		uint32_t color)
-{
-	int r = (color >> 16) & 0xff,
-		g = (color >>  8) & 0xff,
-		b = (color >>  0) & 0xff;
-
-	SDL_Rect rect = {
-		.x = x,
-		.y = y,
-		.w = w,
-		.h = h
-	};
-
-	SDL_SetRenderDrawColor(ctx->renderer, r, g, b, 0xff);
-	SDL_RenderFillRect(ctx->renderer, &rect);
-}
+	replay_free_game(game);
 
-void begin_draw(struct sdl_context *ctx)
-{
-	SDL_SetRenderDrawColor(ctx->renderer, 0, 0, 0, 255);
-	SDL_RenderClear(ctx->renderer);
-}
+	if ((ret = replay_read_game(fp, game)) <= 0)
+		return ret;
 
-void end_draw(struct sdl_context *ctx)
-{
-	SDL_RenderPresent(ctx->renderer);
-}
+	if (game->map->n_rows != map->n_rows ||
+			game->map->n_cols != map->n_cols ||
+			replay_start(game, map) < 0)
+		return -1;
 
-void get_window_size(struct sdl_context *ctx, int *ww, int *wh)
-{
-	SDL_GetWindowSize(ctx->win, ww, wh);
+	return 1;
 }
 
-void delay(const struct sdl_context *ctx, int ms)
+int
+main(int argc, char **argv)
 {
-	(void) ctx;
-	SDL_Delay(ms);
-}
+	int score = 0;
+	struct level *level;
+	struct map *map;
+	struct sdl_context sdl_context;
+	enum map_block_type dir;
+	enum map_snake_state state;
+	struct replay replay;
+	FILE *replay_fp = NULL;
+	struct replay_game game = { 0 };
+	FILE *play_fp = NULL;
+	size_t turn = 0;
+	int play_ret = 1;
+	struct loop loop;
+	struct export export;
+	const char *export_name = NULL;
+	int ticks, opt;
+	SDL_Event event;
+	bool paused = false;
+	bool should_close = false;
 
-void render_map(struct sdl_context *ctx, struct map *map, int cz)
-{
-	int food_texture            = load_texture(ctx, "./gfx/apple.png");
-
-	int vib_texture_down_left   = load_texture(ctx, "./gfx/body_down_left.png");
-	int vib_texture_down_right  = load_texture(ctx, "./gfx/body_down_right.png");
-	int vib_texture_horizontal  = load_texture(ctx, "./gfx/body_horizontal.png");
-	int vib_texture_up_left     = load_texture(ctx, "./gfx/body_up_left.png");
-	int vib_texture_up_right    = load_texture(ctx, "./gfx/body_up_right.png");
-	int vib_texture_vertical    = load_texture(ctx, "./gfx/body_vertical.png");
-
-	int vib_texture_tail_left   = load_texture(ctx, "./gfx/tail_left.png");
-	int vib_texture_tail_right  = load_texture(ctx, "./gfx/tail_right.png");
-	int vib_texture_tail_down   = load_texture(ctx, "./gfx/tail_down.png");
-	int vib_texture_tail_up     = load_texture(ctx, "./gfx/tail_up.png");
-
-	int vib_texture_head_left   = load_texture(ctx, "./gfx/head_left.png");
-	int vib_texture_head_right  = load_texture(ctx, "./gfx/head_right.png");
-	int vib_texture_head_down   = load_texture(ctx, "./gfx/head_down.png");
-	int vib_texture_head_up     = load_texture(ctx, "./gfx/head_up.png");
-
-	int ww, wh;
-	get_window_size(ctx, &ww, &wh);
-	int cam_x = map->head_col * cz - (ww - cz) / 2;
-	int cam_y = map->head_row * cz - (wh - cz) / 2;
-
-	// Render background (space).
-	for (size_t x = 0; x < map->n_cols; ++x)
+	while ((opt = getopt(argc, argv, "e:r:")) != -1)
 	{
-		for (size_t y = 0; y < map->n_rows; ++y)
+		switch (opt)
 		{
-			render_rect(
-				ctx,
-				x * cz - cam_x,
-				y * cz - cam_y,
-				cz,
-				cz,
-				0x090909 * ((x + y) % 2 == 0)
-			);
+			case 'e': export_name = optarg; break;
+			case 'r': play_fp = fopen(optarg, "rb"); break;
+			default: goto usage;
 		}
-	}
-
-	// Render snake.
-	size_t pr, pc, r, c, nr, nc;
-	enum map_block_type prev, cur, next;
-	int is_head = 0, is_tail;
 
-	r = map->tail_row;
-	c = map->tail_col;
+		if (opt == 'r' && NULL == play_fp)
+			goto usage;
+	}
 
-	while (!is_head)
+	if (NULL != play_fp)
 	{
-		int text = -1;
-
-		is_tail = c == map->tail_col && r == map->tail_row;
-		is_head = c == map->head_col && r == map->head_row;
-
-		map_find_snake_next_block(map, r, c, &nr, &nc);
-
-		cur = map->map[r][c];
-
-		if (is_tail) switch (cur)
-		{
-			case MAP_BLOCK_SNAKE_LEFT:
-				text = vib_texture_tail_left;
-				break;
-			case MAP_BLOCK_SNAKE_RIGHT:
-				text = vib_texture_tail_right;
-				break;
-			case MAP_BLOCK_SNAKE_UP:
-				text = vib_texture_tail_up;
-				break;
-			case MAP_BLOCK_SNAKE_DOWN:
-				text = vib_texture_tail_down;
-				break;
-		}
-
-		if (is_head) switch (cur)
-		{
-			case MAP_BLOCK_SNAKE_LEFT:
-				text = vib_texture_head_left;
-				break;
-			case MAP_BLOCK_SNAKE_RIGHT:
-				text = vib_texture_head_right;
-				break;
-			case MAP_BLOCK_SNAKE_UP:
-				text = vib_texture_head_up;
-				break;
-			case MAP_BLOCK_SNAKE_DOWN:
-				text = vib_texture_head_down;
-				break;
-		}
-
-		if (!is_head && !is_tail)
-		{
-			next = map->map[nr][nc];
-			prev = map->map[pr][pc];
-
-			if (cur == prev)
-			{
-				switch (cur)
-				{
-					case MAP_BLOCK_SNAKE_DOWN:
-					case MAP_BLOCK_SNAKE_UP:
-						text = vib_texture_vertical;
-						break;
-					case MAP_BLOCK_SNAKE_LEFT:
-					case MAP_BLOCK_SNAKE_RIGHT:
-						text = vib_texture_horizontal;
-						break;
-				}
-			}
-			else
-			{
-				if ((prev == MAP_BLOCK_SNAKE_DOWN
-						&& cur == MAP_BLOCK_SNAKE_LEFT)
-						|| (prev == MAP_BLOCK_SNAKE_RIGHT
-							&& cur == MAP_BLOCK_SNAKE_UP))
-				{
-					text = vib_texture_down_left;
-				}
-				else if ((prev == MAP_BLOCK_SNAKE_UP
-							&& cur == MAP_BLOCK_SNAKE_LEFT)
-						|| (prev == MAP_BLOCK_SNAKE_RIGHT
-							&& cur == MAP_BLOCK_SNAKE_DOWN))
-				{
-					text = vib_texture_up_left;
-				}
-				else if ((prev == MAP_BLOCK_SNAKE_DOWN
-							&& cur == MAP_BLOCK_SNAKE_RIGHT)
-						|| (prev == MAP_BLOCK_SNAKE_LEFT
-							&& cur == MAP_BLOCK_SNAKE_UP))
-				{
-					text = vib_texture_down_right;
-				}
-				else if ((prev == MAP_BLOCK_SNAKE_UP
-							&& cur == MAP_BLOCK_SNAKE_RIGHT)
-						|| (prev == MAP_BLOCK_SNAKE_LEFT
-							&& cur == MAP_BLOCK_SNAKE_DOWN))
-				{
-					text = vib_texture_up_right;
-				}
-			}
-		}
+		// Playing back a replay, which holds the maps of its games.
+		level = NULL;
 
-		render_texture(ctx, text, c * cz - cam_x, r * cz - cam_y, cz, cz);
+		if (optind != argc || replay_read_game(play_fp, &game) <= 0)
+			goto usage;
 
-		pr = r;
-		pc = c;
-		c = nc;
-		r = nr;
+		if (NULL == (map = map_create(game.map->n_rows,
+						game.map->n_cols)) ||
+				replay_start(&game, map) < 0)
+			fail("out of memory");
 	}
-
-	// Render walls and food.
-	MAP_FOR_EACH_BLOCK(map, row, col, block) switch (block)
+	else
 	{
-		case MAP_BLOCK_FOOD:
-			render_texture(
-				ctx,
-				food_texture,
-				col * cz - cam_x,
-				row * cz - cam_y,
-				cz,
-				cz
-			);
-			break;
-		case MAP_BLOCK_WALL:
-			render_rect(ctx, col*cz - cam_x, row*cz-cam_y, cz, cz, 0x349eeb);
-			break;
-	}
-}
+		if (optind == argc ||
+				NULL == (level = level_load(argv[optind])) ||
+				(argc - optind > 1 &&
+				 NULL == (replay_fp = fopen(argv[optind + 1], "wb"))))
+			goto usage;
 
-int
-main(int argc, char **argv)
-{
-	int score = 0;
-	struct map map;
-	struct sdl_context sdl_context;
-	enum map_block_type dir;
-	enum map_snake_state state;
-	int c;
-	SDL_Event event;
-	bool paused = false;
+		if (NULL == (map = level_new_map(level)))
+			fail("out of memory");
 
-	if (argc < 2 || map_parse_file(&map, argv[1]) < 0)
-	{
-		fprintf(stderr, "usage: viborita_sdl [valid_map_path]\n");
-		return 1;
+		// Seed the food generator with the current process id.
+		map_seed(map, getpid());
 	}
 
+	if (export_open(&export, export_name, map) < 0)
+		fail("can't export the game state");
+
+	replay_begin(&replay, replay_fp, map);
+
 	init_context(&sdl_context);
+	build_static_layer(&sdl_context, map);
+	loop_init(&loop, TICK_PERIOD);
 
-	while (1)
+	while (!should_close)
 	{
-		dir = MAP_BLOCK_INVALID;
-
 		while (SDL_PollEvent(&event))
 		{
 			switch (event.type)
 			{
-				case SDL_QUIT: return 0;
+				case SDL_QUIT: should_close = true; break;
 				case SDL_KEYDOWN:
 					switch (event.key.keysym.sym)
 					{
@@ -403,56 +241,109 @@ main(int argc, char **argv)
 						case SDLK_j: dir = MAP_BLOCK_SNAKE_DOWN;  break;
 						case SDLK_k: dir = MAP_BLOCK_SNAKE_UP;    break;
 						case SDLK_l: dir = MAP_BLOCK_SNAKE_RIGHT; break;
-						case SDLK_SPACE: paused = !paused; break;
+						case SDLK_SPACE: paused = !paused; continue;
+						default: continue;
 					}
+					// Turns come from the replay when playing one
+					// back.
+					if (NULL != play_fp)
+						break;
+					// Queued, so a quick sequence of turns is
+					// taken one per tick instead of only the last.
+					map_queue_direction(map, dir, loop_now());
+					paused = false;
 					break;
 			}
 		}
 
-		if (dir != MAP_BLOCK_INVALID)
-		{
-			map_set_snake_direction(&map, dir);
-			paused = false;
-		}
-
-		if (!paused)
+		for (ticks = loop_ticks(&loop); ticks > 0 && !paused; --ticks)
 		{
-			map_advance(&map, &state);
+			if (NULL == play_fp)
+			{
+				map_advance(map, &state);
+				replay_turn(&replay, map);
+			}
+			else if ((play_ret = replay_step(&game, map, &turn,
+							&state)) == 0)
+			{
+				// Go on with the next game once one is over, its
+				// walls may differ from the last one's.
+				if ((play_ret = next_game(play_fp, &game, map)) <= 0)
+				{
+					should_close = true;
+					break;
+				}
+				build_static_layer(&sdl_context, map);
+				turn = 0;
+				score = 0;
+				continue;
+			}
+			else if (play_ret < 0)
+			{
+				should_close = true;
+				break;
+			}
 
 			switch (state)
 			{
 				case MAP_SNAKE_EATING:
-					play_sound(
-						&sdl_context,
-						load_sound(
-							&sdl_context,
-							"./sfx/chomp.wav"
-						)
-					);
-					map_spawn_food(&map);
+					play_sound(&sdl_context, SOUND_CHOMP);
+					map_spawn_food(map);
 					score += 1;
 					break;
 				case MAP_SNAKE_DEAD:
-					play_sound(
-						&sdl_context,
-						load_sound(
-							&sdl_context,
-							"./sfx/death.wav"
-						)
-					);
+					play_sound(&sdl_context, SOUND_DEATH);
 					score = 0;
-					map_parse_file(&map, argv[1]);
+					// A replay goes on with its next game on the
+					// next tick.
+					if (NULL != play_fp)
+						break;
+					replay_end(&replay, map);
+					if (level_reset(level, map) < 0)
+						fail("out of memory");
+					replay_begin(&replay, replay_fp, map);
+					break;
+				case MAP_SNAKE_IDLE:
 					break;
 			}
 		}
 
 		begin_draw(&sdl_context);
-		render_map(&sdl_context, &map, 40);
+		render_map(&sdl_context, map, 40);
 		end_draw(&sdl_context);
-		delay(&sdl_context, 80);
+
+		// The renderer draws the whole view every frame, the change
+		// log is only kept for the export.
+		export_publish(&export, map, score);
+		map_clear_changes(map);
+		loop_wait(&loop);
 	}
 
 	fini_context(&sdl_context);
+	export_close(&export);
+
+	if (NULL != replay_fp)
+	{
+		replay_end(&replay, map);
+		fclose(replay_fp);
+	}
+
+	if (NULL != play_fp)
+	{
+		replay_free_game(&game);
+		fclose(play_fp);
+	}
+
+	map_destroy(map);
+	level_destroy(level);
+
+	if (play_ret < 0)
+		fail("invalid replay");
 
 	return 0;
+
+usage:
+	fprintf(stderr, "usage: viborita_sdl [-e shm_name]"
+			" [-r replay_path | valid_map_path [replay_path]]\n");
+	return 1;
 }
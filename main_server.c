@@ -0,0 +1,458 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+/*
+	Serves a game of snake to every client connected to a unix socket.
+
+	The socket is of type SOCK_SEQPACKET, so every message arrives whole.
+	Clients send one byte per turn: 0 up, 1 left, 2 down and 3 right. The
+	server sends, in little endian:
+
+	  map:  0, tick u32, rows u16, cols u16, blocks, two per byte with the
+	        first one in the low nibble, numbered as in enum map_block_type
+	  tick: 1, tick u32, state u8, count u16, count times pos u32, block u8
+
+	A map message with tick 0 starts every game. One is also sent in place
+	of a tick whenever the blocks that changed are too many, or a message
+	could not be sent because the client is not reading. A tick whose
+	state is MAP_SNAKE_DEAD ends the game, whether the snake died or the
+	map filled up, and the next one starts right away.
+
+	A map message holds the whole grid, so the server refuses levels with
+	more than 65535 rows or columns, or whose grid does not fit in one
+	message on the socket.
+*/
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "level.h"
+#include "loop.h"
+#include "map.h"
+
+#define TICK_PERIOD (1000000000 / 15)
+
+/* every session ticks once per turn of the wheel, in the slot given by its
+index, so that a tick of all of them is spread over the whole period */
+#define WHEEL_SLOTS 16
+
+#define MAX_EVENTS 64
+
+/* bytes before the blocks of a map message, and per block of a tick */
+#define MAP_HEADER_SIZE 9
+#define CHANGE_SIZE 5
+
+/* part of the send buffer of a socket that a message can't use */
+#define SNDBUF_OVERHEAD 64
+
+/* epoll ids of the descriptors that are not a session */
+#define ID_LISTEN UINT32_MAX
+#define ID_TIMER (UINT32_MAX - 1)
+
+enum message_type {
+	MESSAGE_MAP,
+	MESSAGE_TICK
+};
+
+struct session {
+	/* -1 while the session is in the free pool */
+	int fd;
+	/* the client missed a message and needs the whole map */
+	bool resync;
+	struct map *map;
+};
+
+static struct level *level;
+static struct session *sessions;
+static uint32_t *free_sessions;
+static size_t n_sessions, n_free_sessions;
+static uint64_t next_seed;
+static uint8_t *out;
+static int sndbuf;
+static int epfd;
+
+static void
+die(const char *fmt, ...)
+{
+	va_list args;
+
+	fputs("viborita_server: ", stderr);
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fputc('\n', stderr);
+	exit(1);
+}
+
+static void
+usage(void)
+{
+	fputs("usage: viborita_server [-n max_sessions] [-s first_seed]"
+			" socket_path map_path\n", stderr);
+	exit(1);
+}
+
+static uint8_t *
+put_u16(uint8_t *p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	return p + 2;
+}
+
+static uint8_t *
+put_u32(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+	return p + 4;
+}
+
+static void
+close_session(struct session *session)
+{
+	close(session->fd);
+	session->fd = -1;
+	free_sessions[n_free_sessions++] = session - sessions;
+}
+
+/* returns false when the session was closed */
+static bool
+send_message(struct session *session, size_t len)
+{
+	if (send(session->fd, out, len, MSG_DONTWAIT | MSG_NOSIGNAL) >= 0) {
+		session->resync = false;
+		return true;
+	}
+
+	/* a client that is behind gets the whole map once it reads again */
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+		session->resync = true;
+		return true;
+	}
+
+	close_session(session);
+	return false;
+}
+
+static bool
+send_map(struct session *session)
+{
+	const struct map *map = session->map;
+	size_t n_bytes = (map->n_rows * map->n_cols + 1) / 2;
+	uint8_t *p = out;
+
+	*p++ = MESSAGE_MAP;
+	p = put_u32(p, map->tick);
+	p = put_u16(p, map->n_rows);
+	p = put_u16(p, map->n_cols);
+	memcpy(p, map->blocks, n_bytes);
+
+	return send_message(session, p + n_bytes - out);
+}
+
+static bool
+send_tick(struct session *session, enum map_snake_state state)
+{
+	struct map *map = session->map;
+	uint8_t *p = out;
+
+	if (session->resync || map->all_changed)
+		return send_map(session);
+
+	*p++ = MESSAGE_TICK;
+	p = put_u32(p, map->tick);
+	*p++ = state;
+	p = put_u16(p, map->n_changes);
+
+	MAP_FOR_EACH_CHANGED_BLOCK(map, i, row, col) {
+		p = put_u32(p, map->changes[i]);
+		*p++ = MAP_BLOCK_AT(map, row, col);
+	}
+
+	return send_message(session, p - out);
+}
+
+/* returns false when the session was closed */
+static bool
+new_game(struct session *session)
+{
+	if (level_reset(level, session->map) < 0)
+		die("out of memory");
+
+	map_seed(session->map, next_seed++);
+	map_clear_changes(session->map);
+
+	return send_map(session);
+}
+
+static void
+open_session(int listen_fd)
+{
+	struct epoll_event ev;
+	struct session *session;
+	int fd;
+
+	if ((fd = accept(listen_fd, NULL, NULL)) < 0)
+		return;
+
+	if (n_free_sessions == 0) {
+		close(fd);
+		return;
+	}
+
+	/* sockets don't take the send buffer of the one they come from */
+	setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+	session = &sessions[free_sessions[--n_free_sessions]];
+	session->fd = fd;
+
+	ev.events = EPOLLIN;
+	ev.data.u32 = session - sessions;
+
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		close_session(session);
+		return;
+	}
+
+	new_game(session);
+}
+
+static void
+read_input(struct session *session)
+{
+	uint8_t in[MAP_MAX_INPUTS];
+	ssize_t n, i;
+
+	if ((n = recv(session->fd, in, sizeof(in), MSG_DONTWAIT)) < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			close_session(session);
+		return;
+	}
+
+	if (n == 0) {
+		close_session(session);
+		return;
+	}
+
+	/* turns that can't be queued are dropped, as with a key pressed
+	too many times in a frontend */
+	for (i = 0; i < n; ++i)
+		if (in[i] < 4)
+			map_queue_direction(session->map,
+					MAP_BLOCK_SNAKE_UP + in[i], session->map->tick);
+}
+
+static void
+tick_session(struct session *session)
+{
+	enum map_snake_state state;
+	bool over;
+
+	if (map_advance(session->map, &state) < 0)
+		die("out of memory");
+
+	over = state == MAP_SNAKE_DEAD;
+
+	if (state == MAP_SNAKE_EATING && map_spawn_food(session->map) < 0)
+		over = true;
+
+	/* a full map ends the game as well, so clients are told about it */
+	if (!send_tick(session, over ? MAP_SNAKE_DEAD : state))
+		return;
+
+	map_clear_changes(session->map);
+
+	if (over)
+		new_game(session);
+}
+
+static void
+tick_slot(size_t slot)
+{
+	size_t i;
+
+	for (i = slot; i < n_sessions; i += WHEEL_SLOTS)
+		if (sessions[i].fd >= 0)
+			tick_session(&sessions[i]);
+}
+
+static int
+listen_on(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		die("socket path too long: %s", path);
+
+	strcpy(addr.sun_path, path);
+	unlink(path);
+
+	if ((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) < 0 ||
+			bind(fd, (struct sockaddr *)(&addr), sizeof(addr)) < 0 ||
+			listen(fd, SOMAXCONN) < 0)
+		die("can't listen on %s: %s", path, strerror(errno));
+
+	return fd;
+}
+
+/* makes the send buffer of a socket big enough for a map message, or
+dies if the system does not allow one that big */
+static void
+size_sndbuf(int fd, size_t msg_size)
+{
+	socklen_t len = sizeof(sndbuf);
+	int got;
+
+	if (msg_size + SNDBUF_OVERHEAD > INT_MAX / 2)
+		die("map too big to send: %zu bytes", msg_size);
+
+	/* the system doubles what it is asked for, and reports that */
+	sndbuf = msg_size + SNDBUF_OVERHEAD;
+	setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+	if (getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &got, &len) < 0)
+		die("getsockopt failed: %s", strerror(errno));
+
+	if (msg_size + SNDBUF_OVERHEAD > (size_t)(got))
+		die("map too big to send: %zu bytes, sockets take %d",
+				msg_size, got - SNDBUF_OVERHEAD);
+}
+
+static void
+add_fd(int fd, uint32_t id)
+{
+	struct epoll_event ev;
+
+	ev.events = EPOLLIN;
+	ev.data.u32 = id;
+
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		die("epoll_ctl failed: %s", strerror(errno));
+}
+
+int
+main(int argc, char **argv)
+{
+	struct epoll_event events[MAX_EVENTS];
+	struct loop loop;
+	struct session *session;
+	size_t i, slot, n_bytes;
+	int listen_fd, n_events, n, opt;
+
+	n_sessions = 1024;
+	next_seed = time(NULL);
+
+	while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+		switch (opt) {
+		case 'n': n_sessions = strtoul(optarg, NULL, 10); break;
+		case 's': next_seed = strtoull(optarg, NULL, 10); break;
+		default: usage();
+		}
+	}
+
+	if (optind != argc - 2 || n_sessions == 0 || n_sessions >= ID_TIMER)
+		usage();
+
+	if (NULL == (level = level_load(argv[optind + 1])))
+		die("invalid map: %s", argv[optind + 1]);
+
+	/* map messages carry the size of the map in 16 bits */
+	if (level->origin->n_rows > UINT16_MAX ||
+			level->origin->n_cols > UINT16_MAX)
+		die("map too big: %zux%zu, at most %u rows and columns",
+				level->origin->n_rows, level->origin->n_cols, UINT16_MAX);
+
+	/* a tick header is shorter than that of a map */
+	n_bytes = (level->origin->n_rows * level->origin->n_cols + 1) / 2;
+	if (n_bytes < MAP_MAX_CHANGES * CHANGE_SIZE)
+		n_bytes = MAP_MAX_CHANGES * CHANGE_SIZE;
+
+	if (NULL == (out = malloc(MAP_HEADER_SIZE + n_bytes)))
+		die("out of memory");
+
+	if ((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		die("epoll_create1 failed: %s", strerror(errno));
+
+	listen_fd = listen_on(argv[optind]);
+	size_sndbuf(listen_fd, MAP_HEADER_SIZE + n_bytes);
+	add_fd(listen_fd, ID_LISTEN);
+
+	/* every map is made up front, a session only takes one from the pool */
+	if (NULL == (sessions = calloc(n_sessions, sizeof(sessions[0]))) ||
+			NULL == (free_sessions = calloc(n_sessions,
+					sizeof(free_sessions[0]))))
+		die("out of memory");
+
+	for (i = 0; i < n_sessions; ++i) {
+		if (NULL == (sessions[i].map = level_new_map(level)))
+			die("out of memory");
+		sessions[i].fd = -1;
+		free_sessions[n_free_sessions++] = n_sessions - 1 - i;
+	}
+
+	loop_init(&loop, TICK_PERIOD / WHEEL_SLOTS);
+	if (loop_open_timer(&loop) < 0)
+		die("can't create timer: %s", strerror(errno));
+	add_fd(loop.timer_fd, ID_TIMER);
+
+	slot = 0;
+
+	while (1) {
+		if ((n_events = epoll_wait(epfd, events, MAX_EVENTS, -1)) < 0) {
+			if (errno == EINTR)
+				continue;
+			die("epoll_wait failed: %s", strerror(errno));
+		}
+
+		for (i = 0; i < (size_t)(n_events); ++i) {
+			switch (events[i].data.u32) {
+			case ID_LISTEN:
+				open_session(listen_fd);
+				break;
+			case ID_TIMER:
+				for (n = loop_ticks(&loop); n > 0; --n, ++slot)
+					tick_slot(slot % WHEEL_SLOTS);
+				break;
+			default:
+				session = &sessions[events[i].data.u32];
+				/* closed by an earlier event in this batch */
+				if (session->fd >= 0)
+					read_input(session);
+			}
+		}
+	}
+
+	return 0;
+}
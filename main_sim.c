@@ -0,0 +1,340 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "map.h"
+#include "level.h"
+
+/* games taken from the shared counter at once by each worker */
+#define GAMES_PER_BATCH 64
+
+enum death_cause {
+	DEATH_WALL,
+	DEATH_SELF,
+	DEATH_EDGE,
+	DEATH_TIMEOUT,
+	DEATH_FULL,
+	DEATH_CAUSE_COUNT
+};
+
+static const char *death_cause_names[DEATH_CAUSE_COUNT] = {
+	[DEATH_WALL] = "wall",
+	[DEATH_SELF] = "self",
+	[DEATH_EDGE] = "edge",
+	[DEATH_TIMEOUT] = "timeout",
+	[DEATH_FULL] = "full"
+};
+
+typedef enum map_block_type (*policy_fn)(const struct map *, struct map_rng *);
+
+struct worker {
+	pthread_t thread;
+	uint64_t steps;
+	uint64_t deaths[DEATH_CAUSE_COUNT];
+	/* keep workers that update their counters on separate cache lines */
+	char pad[64];
+};
+
+static struct level *level;
+static policy_fn policy;
+static uint64_t first_seed;
+static size_t n_games, max_steps;
+static uint32_t *scores;
+static atomic_size_t next_game;
+
+static void
+die(const char *fmt, ...)
+{
+	va_list args;
+
+	fputs("viborita_sim: ", stderr);
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fputc('\n', stderr);
+	exit(1);
+}
+
+static void
+usage(void)
+{
+	fputs("usage: viborita_sim [-j threads] [-n games] [-s first_seed]"
+			" [-m max_steps] [-p straight|random|safe] map_path\n", stderr);
+	exit(1);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* direction the snake is heading in */
+static enum map_block_type
+heading(const struct map *map)
+{
+	const struct map_snake *snake = &map->snakes[0];
+	return MAP_BLOCK_AT(map, snake->head_row, snake->head_col);
+}
+
+/* block the head would move into, MAP_BLOCK_INVALID outside the map */
+static enum map_block_type
+peek(const struct map *map, enum map_block_type dir)
+{
+	size_t row, col;
+
+	row = map->snakes[0].head_row;
+	col = map->snakes[0].head_col;
+
+	switch (dir) {
+	case MAP_BLOCK_SNAKE_UP:    row -= 1; break;
+	case MAP_BLOCK_SNAKE_DOWN:  row += 1; break;
+	case MAP_BLOCK_SNAKE_LEFT:  col -= 1; break;
+	case MAP_BLOCK_SNAKE_RIGHT: col += 1; break;
+	default: return MAP_BLOCK_INVALID;
+	}
+
+	/* row and col wrap around when going past zero */
+	if (!map_contains(map, row, col))
+		return MAP_BLOCK_INVALID;
+
+	return MAP_BLOCK_AT(map, row, col);
+}
+
+static bool
+is_safe(const struct map *map, enum map_block_type dir)
+{
+	enum map_block_type next = peek(map, dir);
+	return next == MAP_BLOCK_SPACE || next == MAP_BLOCK_FOOD;
+}
+
+static enum map_block_type
+policy_straight(const struct map *map, struct map_rng *rng)
+{
+	(void) rng;
+	return heading(map);
+}
+
+static enum map_block_type
+policy_random(const struct map *map, struct map_rng *rng)
+{
+	(void) map;
+	return MAP_BLOCK_SNAKE_UP + map_rng_bounded(rng, 4);
+}
+
+static enum map_block_type
+policy_safe(const struct map *map, struct map_rng *rng)
+{
+	enum map_block_type dir, safe[4];
+	int n_safe = 0;
+
+	dir = heading(map);
+
+	/* turn now and then so the snake does not circle the map forever */
+	if (is_safe(map, dir) && map_rng_bounded(rng, 8) != 0)
+		return dir;
+
+	for (dir = MAP_BLOCK_SNAKE_UP; dir <= MAP_BLOCK_SNAKE_RIGHT; ++dir)
+		if (is_safe(map, dir))
+			safe[n_safe++] = dir;
+
+	if (n_safe == 0)
+		return heading(map);
+
+	return safe[map_rng_bounded(rng, n_safe)];
+}
+
+static enum death_cause
+play(struct map *map, uint64_t seed, uint64_t *steps, uint32_t *score)
+{
+	enum map_snake_state state;
+	enum map_block_type next;
+	struct map_rng rng;
+
+	/* the policy draws from its own stream so it never shifts the food */
+	map_seed(map, seed);
+	map_rng_seed(&rng, seed, 1);
+	*score = 0;
+
+	for (*steps = 0; *steps < max_steps; ++*steps) {
+		map_set_snake_direction(map, policy(map, &rng));
+		next = peek(map, heading(map));
+
+		if (map_advance(map, &state) < 0)
+			die("out of memory");
+
+		switch (state) {
+		case MAP_SNAKE_DEAD:
+			return next == MAP_BLOCK_WALL ? DEATH_WALL :
+			       next == MAP_BLOCK_INVALID ? DEATH_EDGE : DEATH_SELF;
+		case MAP_SNAKE_EATING:
+			*score += 1;
+			if (map_spawn_food(map) < 0)
+				return DEATH_FULL;
+			break;
+		case MAP_SNAKE_IDLE:
+			break;
+		}
+	}
+
+	return DEATH_TIMEOUT;
+}
+
+static void *
+work(void *arg)
+{
+	struct worker *worker;
+	struct map *map;
+	size_t first, last, game;
+	uint64_t steps;
+
+	worker = arg;
+
+	if (NULL == (map = level_new_map(level)))
+		die("out of memory");
+
+	while ((first = atomic_fetch_add(&next_game, GAMES_PER_BATCH)) < n_games) {
+		last = first + GAMES_PER_BATCH;
+		if (last > n_games)
+			last = n_games;
+
+		for (game = first; game < last; ++game) {
+			if (level_reset(level, map) < 0)
+				die("out of memory");
+			worker->deaths[play(map, first_seed + game, &steps,
+					&scores[game])] += 1;
+			worker->steps += steps;
+		}
+	}
+
+	map_destroy(map);
+
+	return NULL;
+}
+
+static int
+compare_scores(const void *a, const void *b)
+{
+	uint32_t sa = *(const uint32_t *)(a), sb = *(const uint32_t *)(b);
+	return (sa > sb) - (sa < sb);
+}
+
+static void
+report(const struct worker *workers, size_t n_workers, double elapsed)
+{
+	uint64_t steps, deaths[DEATH_CAUSE_COUNT];
+	double mean;
+	size_t i, cause;
+
+	steps = 0;
+	memset(deaths, 0, sizeof(deaths));
+
+	for (i = 0; i < n_workers; ++i) {
+		steps += workers[i].steps;
+		for (cause = 0; cause < DEATH_CAUSE_COUNT; ++cause)
+			deaths[cause] += workers[i].deaths[cause];
+	}
+
+	qsort(scores, n_games, sizeof(scores[0]), compare_scores);
+
+	for (mean = 0, i = 0; i < n_games; ++i)
+		mean += scores[i];
+	mean /= n_games;
+
+	printf("games: %zu  threads: %zu\n", n_games, n_workers);
+	printf("steps: %llu  elapsed: %.3fs  steps/sec: %.0f\n",
+			(unsigned long long)(steps), elapsed, steps / elapsed);
+	printf("score: min %u  mean %.2f  p50 %u  p90 %u  p99 %u  max %u\n",
+			scores[0], mean, scores[n_games / 2],
+			scores[n_games * 9 / 10], scores[n_games * 99 / 100],
+			scores[n_games - 1]);
+	printf("deaths:");
+	for (cause = 0; cause < DEATH_CAUSE_COUNT; ++cause)
+		printf("  %s %llu", death_cause_names[cause],
+				(unsigned long long)(deaths[cause]));
+	putchar('\n');
+}
+
+int
+main(int argc, char **argv)
+{
+	struct worker *workers;
+	size_t n_workers, i;
+	double start;
+	int opt;
+
+	n_workers = sysconf(_SC_NPROCESSORS_ONLN);
+	n_games = 1000;
+	max_steps = 10000;
+	first_seed = 0;
+	policy = policy_safe;
+
+	while ((opt = getopt(argc, argv, "j:n:s:m:p:")) != -1) {
+		switch (opt) {
+		case 'j': n_workers = strtoul(optarg, NULL, 10); break;
+		case 'n': n_games = strtoul(optarg, NULL, 10); break;
+		case 's': first_seed = strtoull(optarg, NULL, 10); break;
+		case 'm': max_steps = strtoul(optarg, NULL, 10); break;
+		case 'p':
+			if (strcmp(optarg, "straight") == 0) policy = policy_straight;
+			else if (strcmp(optarg, "random") == 0) policy = policy_random;
+			else if (strcmp(optarg, "safe") == 0) policy = policy_safe;
+			else usage();
+			break;
+		default: usage();
+		}
+	}
+
+	if (optind != argc - 1 || n_workers == 0 || n_games == 0)
+		usage();
+
+	if (NULL == (level = level_load(argv[optind])))
+		die("invalid map: %s", argv[optind]);
+
+	if (NULL == (scores = calloc(n_games, sizeof(scores[0]))) ||
+			NULL == (workers = calloc(n_workers, sizeof(workers[0]))))
+		die("out of memory");
+
+	start = now();
+
+	for (i = 0; i < n_workers; ++i)
+		if (pthread_create(&workers[i].thread, NULL, work, &workers[i]) != 0)
+			die("can't create worker thread");
+
+	for (i = 0; i < n_workers; ++i)
+		pthread_join(workers[i].thread, NULL);
+
+	report(workers, n_workers, now() - start);
+
+	free(workers);
+	free(scores);
+	level_destroy(level);
+
+	return 0;
+}
@@ -0,0 +1,150 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "level.h"
+#include "map.h"
+
+#define TEST_ROWS 1024
+#define TEST_COLS 1024
+#define TEST_TICKS 200000
+
+static void
+fail(const char *fmt, ...)
+{
+	va_list args;
+
+	fputs("viborita_test: ", stderr);
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fputc('\n', stderr);
+	exit(1);
+}
+
+/* walled map with a short snake heading right from the top left corner */
+static char *
+generate_map_str(size_t n_rows, size_t n_cols)
+{
+	size_t row, col;
+	char *map_str, *p;
+
+	if (NULL == (map_str = malloc(n_rows * (n_cols + 1) + 1)))
+		fail("out of memory");
+
+	for (p = map_str, row = 0; row < n_rows; ++row) {
+		for (col = 0; col < n_cols; ++col) {
+			if (row == 0 || col == 0 || row == n_rows - 1 ||
+					col == n_cols - 1)
+				*p++ = '=';
+			else if (row == 1 && col < 6)
+				*p++ = '>';
+			else if (row == n_rows / 2 && col == n_cols / 2)
+				*p++ = '*';
+			else
+				*p++ = ' ';
+		}
+		*p++ = '\n';
+	}
+
+	*p = '\0';
+
+	return map_str;
+}
+
+/* sweeps the map row by row, turning down and back at each side wall */
+static void
+steer(struct map *map)
+{
+	const struct map_snake *snake = &map->snakes[0];
+	enum map_block_type dir;
+
+	dir = MAP_BLOCK_AT(map, snake->head_row, snake->head_col);
+
+	if (dir == MAP_BLOCK_SNAKE_DOWN)
+		map_set_snake_direction(map, snake->head_col == 1 ?
+				MAP_BLOCK_SNAKE_RIGHT : MAP_BLOCK_SNAKE_LEFT);
+	else if ((dir == MAP_BLOCK_SNAKE_RIGHT &&
+				snake->head_col == map->n_cols - 2) ||
+			(dir == MAP_BLOCK_SNAKE_LEFT && snake->head_col == 1))
+		map_set_snake_direction(map, MAP_BLOCK_SNAKE_DOWN);
+}
+
+/* a long game on a big map must not let the journal take more memory
+   than the grid it saves map_rewind from copying, and rewinding must
+   still give back the level */
+static void
+test_journal_size(void)
+{
+	struct level level;
+	enum map_snake_state state;
+	struct map *map;
+	char *map_str, *str;
+	size_t limit, ticks;
+
+	map_str = generate_map_str(TEST_ROWS, TEST_COLS);
+
+	if (NULL == (level.origin = map_parse(map_str)) ||
+			NULL == (map = level_new_map(&level)) ||
+			NULL == (str = malloc(MAP_STR_SIZE(map))))
+		fail("out of memory");
+
+	limit = map_grid_size(map);
+
+	for (ticks = 0; ticks < TEST_TICKS; ++ticks) {
+		steer(map);
+
+		if (map_advance(map, &state) < 0)
+			fail("out of memory");
+
+		if (state == MAP_SNAKE_DEAD)
+			fail("snake died at tick %zu", ticks);
+
+		if (state == MAP_SNAKE_EATING)
+			map_spawn_food(map);
+
+		if (map->journal_cap * sizeof(struct map_undo) > limit)
+			fail("journal of %zu bytes at tick %zu, over the %zu of "
+					"the grid", map->journal_cap * sizeof(struct map_undo),
+					ticks, limit);
+	}
+
+	if (level_reset(&level, map) < 0)
+		fail("out of memory");
+
+	map_stringify(map, MAP_STR_SIZE(map), str);
+
+	if (strcmp(str, map_str) != 0)
+		fail("map differs from the level after level_reset");
+
+	free(str);
+	free(map_str);
+	map_destroy(map);
+	map_destroy(level.origin);
+}
+
+int
+main(void)
+{
+	test_journal_size();
+	puts("viborita_test: ok");
+	return 0;
+}
@@ -16,6 +16,8 @@
 
 */
 
+#include <errno.h>
+#include <poll.h>
 #include <stdbool.h>
 #include <stdarg.h>
 #include <stdint.h>
@@ -23,27 +25,90 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 #include <xcb/xcb.h>
 #include <xcb/xcb_keysyms.h>
+#include <xcb/shm.h>
 #include <xcb/xproto.h>
 #include <xkbcommon/xkbcommon-keysyms.h>
 #include "map.h"
+#include "level.h"
+#include "replay.h"
+#include "view.h"
+#include "loop.h"
+#include "export.h"
 
 #define VIBORITA_WM_NAME "viborita"
 #define VIBORITA_WM_CLASS "viborita\0viborita\0"
 
-static struct map map;
+/* time between two steps of the snake, in nanoseconds */
+#define TICK_PERIOD (1000000000 / 15)
+
+/* upper bound on the rectangles sent in one poly fill request */
+#define BATCH_MAX_RECTS 16384
+
+enum {
+	BATCH_SPACE_EVEN,
+	BATCH_SPACE_ODD,
+	BATCH_FOOD,
+	BATCH_WALL,
+	BATCH_SNAKE,
+	BATCH_COUNT
+};
+
+/* rectangles waiting to be filled with the same gc in a single request */
+struct batch {
+	xcb_gcontext_t gc;
+	uint32_t len;
+	xcb_rectangle_t *rects;
+};
+
+/* colors of the blocks in each batch, as 0xrrggbb */
+static const uint32_t batch_colors[BATCH_COUNT] = {
+	[BATCH_SPACE_EVEN] = 0x000000,
+	[BATCH_SPACE_ODD] = 0x090909,
+	[BATCH_FOOD] = 0xc10b26,
+	[BATCH_WALL] = 0xffffff,
+	[BATCH_SNAKE] = 0xc4f669
+};
+
+/* blocks from row_begin to row_end and col_begin to col_end, see cache_reset */
+struct cache {
+	xcb_pixmap_t pixmap;
+	int block_size;
+	size_t n_rows, n_cols;
+	size_t row_begin, row_end;
+	size_t col_begin, col_end;
+};
+
+/* window sized image shared with the server, when the display is local */
+struct shm {
+	bool enabled, busy;
+	xcb_shm_seg_t seg;
+	uint32_t *pixels;
+	uint32_t width, height;
+};
+
+static struct level *level;
+static struct map *map;
+static struct replay replay;
+static struct replay_game game;
+static FILE *play_fp;
+static struct export export;
 static xcb_connection_t *conn;
 static xcb_screen_t *screen;
 static xcb_window_t window;
-static xcb_gcontext_t gc_space[2];
-static xcb_gcontext_t gc_food;
-static xcb_gcontext_t gc_wall;
-static xcb_gcontext_t gc_snake;
+static struct batch batches[BATCH_COUNT];
+static uint32_t batch_cap;
+static struct cache cache;
+static struct view view;
+static xcb_gcontext_t gc_copy;
+static struct shm shm;
 static xcb_key_symbols_t *ksyms;
 static uint32_t width, height;
-static int zoom;
-static bool should_close, paused;
+static int zoom, score;
+static bool should_close, paused, redraw;
 
 static void
 die(const char *fmt, ...)
@@ -88,9 +153,94 @@ xcolor(uint32_t fg)
 	return gc;
 }
 
+/* the image is only shared if the server takes it as 32 bit 0xrrggbb */
+static void
+shm_init(void)
+{
+	const xcb_query_extension_reply_t *ext;
+	xcb_format_iterator_t it;
+	uint32_t one = 1;
+
+	ext = xcb_get_extension_data(conn, &xcb_shm_id);
+
+	if (NULL == ext || !ext->present || screen->root_depth != 24 ||
+			xcb_get_setup(conn)->image_byte_order !=
+			(*(uint8_t *)(&one) ? XCB_IMAGE_ORDER_LSB_FIRST :
+			 XCB_IMAGE_ORDER_MSB_FIRST))
+		return;
+
+	it = xcb_setup_pixmap_formats_iterator(xcb_get_setup(conn));
+
+	for (; it.rem > 0; xcb_format_next(&it))
+		if (it.data->depth == screen->root_depth)
+			shm.enabled = it.data->bits_per_pixel == 32;
+}
+
+static void
+shm_free(void)
+{
+	if (NULL == shm.pixels)
+		return;
+
+	xcb_shm_detach(conn, shm.seg);
+	shmdt(shm.pixels);
+	shm.pixels = NULL;
+}
+
+/* falls back to the pixmap cache if the server can't attach the segment */
+static bool
+shm_resize(void)
+{
+	xcb_generic_error_t *error;
+	int id;
+
+	shm_free();
+
+	if ((id = shmget(IPC_PRIVATE, width * height * 4, IPC_CREAT | 0600)) < 0)
+		goto fail;
+
+	shm.pixels = shmat(id, NULL, 0);
+	shm.seg = xcb_generate_id(conn);
+	error = shm.pixels == (void *)(-1) ? NULL :
+		xcb_request_check(conn, xcb_shm_attach_checked(conn, shm.seg, id, 0));
+
+	/* the segment goes away once both sides have detached it */
+	shmctl(id, IPC_RMID, NULL);
+
+	if (shm.pixels == (void *)(-1) || NULL != error) {
+		if (shm.pixels != (void *)(-1))
+			shmdt(shm.pixels);
+		free(error);
+		goto fail;
+	}
+
+	shm.width = width;
+	shm.height = height;
+	shm.busy = false;
+
+	return true;
+
+fail:
+	shm.pixels = NULL;
+	shm.enabled = false;
+	return false;
+}
+
+static void
+shm_present(void)
+{
+	xcb_shm_put_image(conn, window, gc_copy, shm.width, shm.height, 0, 0,
+			shm.width, shm.height, 0, 0, screen->root_depth,
+			XCB_IMAGE_FORMAT_Z_PIXMAP, 0, shm.seg, 0);
+	shm.busy = true;
+	xcb_flush(conn);
+}
+
 static void
 create_window(void)
 {
+	int i;
+
 	if (xcb_connection_has_error(conn = xcb_connect(NULL, NULL)))
 		die("can't open display");
 
@@ -114,11 +264,25 @@ create_window(void)
 		}}
 	);
 
-	gc_food = xcolor(0xc10b26);
-	gc_wall = xcolor(0xffffff);
-	gc_space[0] = xcolor(0x000000);
-	gc_space[1] = xcolor(0x090909);
-	gc_snake = xcolor(0xc4f669);
+	for (i = 0; i < BATCH_COUNT; ++i)
+		batches[i].gc = xcolor(batch_colors[i]);
+
+	gc_copy = xcb_generate_id(conn);
+	xcb_create_gc(conn, gc_copy, window, XCB_GC_GRAPHICS_EXPOSURES,
+			(const uint32_t []) { 0 });
+
+	/* no more rectangles than fit in the largest request the server takes */
+	batch_cap = (xcb_get_maximum_request_length(conn) * 4 -
+			sizeof(xcb_poly_fill_rectangle_request_t)) /
+			sizeof(xcb_rectangle_t);
+
+	if (batch_cap > BATCH_MAX_RECTS)
+		batch_cap = BATCH_MAX_RECTS;
+
+	for (i = 0; i < BATCH_COUNT; ++i)
+		if (NULL == (batches[i].rects = malloc(batch_cap *
+						sizeof(xcb_rectangle_t))))
+			die("out of memory");
 
 	xcb_change_property(
 		conn, XCB_PROP_MODE_REPLACE, window, get_atom("_NET_WM_NAME"),
@@ -138,6 +302,8 @@ create_window(void)
 		(const xcb_atom_t []) { get_atom("WM_DELETE_WINDOW") }
 	);
 
+	shm_init();
+
 	xcb_map_window(conn, window);
 	xcb_flush(conn);
 }
@@ -145,74 +311,278 @@ create_window(void)
 static void
 destroy_window(void)
 {
-	xcb_free_gc(conn, gc_wall);
-	xcb_free_gc(conn, gc_space[0]);
-	xcb_free_gc(conn, gc_space[1]);
-	xcb_free_gc(conn, gc_food);
-	xcb_free_gc(conn, gc_snake);
+	int i;
+
+	for (i = 0; i < BATCH_COUNT; ++i) {
+		xcb_free_gc(conn, batches[i].gc);
+		free(batches[i].rects);
+	}
+
+	xcb_free_gc(conn, gc_copy);
+	xcb_free_pixmap(conn, cache.pixmap);
+	shm_free();
+
 	xcb_key_symbols_free(ksyms);
 	xcb_disconnect(conn);
 }
 
 static void
-render_map(void)
+batch_flush(struct batch *batch)
 {
-	int block_size;
-	int map_x1, map_x2;
-	int map_y1, map_y2;
-	xcb_gcontext_t gc;
+	if (batch->len == 0)
+		return;
+
+	xcb_poly_fill_rectangle(conn, cache.pixmap, batch->gc, batch->len,
+			batch->rects);
+	batch->len = 0;
+}
+
+static void
+batch_add(struct batch *batch, int x, int y, int size)
+{
+	if (batch->len == batch_cap)
+		batch_flush(batch);
+
+	batch->rects[batch->len++] = (xcb_rectangle_t) {
+		.x = x, .y = y, .width = size, .height = size
+	};
+}
+
+/*
+	the cache is a pixmap holding the blocks around the camera. block
+	(row, col) is drawn at (col % n_cols, row % n_rows), so when the camera
+	moves only the rows and columns that scroll into view have to be drawn,
+	over the ones that scrolled out.
+*/
+static void
+cache_reset(int block_size)
+{
+	if (cache.pixmap != XCB_NONE)
+		xcb_free_pixmap(conn, cache.pixmap);
+
+	/* enough blocks to cover the window when they are cut at both ends */
+	cache.block_size = block_size;
+	cache.n_cols = width / block_size + 2;
+	cache.n_rows = height / block_size + 2;
+	cache.row_begin = cache.row_end = 0;
+	cache.col_begin = cache.col_end = 0;
+	cache.pixmap = xcb_generate_id(conn);
+
+	xcb_create_pixmap(conn, screen->root_depth, cache.pixmap, window,
+			cache.n_cols * block_size, cache.n_rows * block_size);
+}
+
+static bool
+cache_contains(size_t row, size_t col)
+{
+	return row >= cache.row_begin && row < cache.row_end &&
+		col >= cache.col_begin && col < cache.col_end;
+}
+
+static int
+block_batch(size_t row, size_t col)
+{
+	switch (MAP_BLOCK_AT(map, row, col)) {
+	case MAP_BLOCK_SPACE: return BATCH_SPACE_EVEN + (row + col) % 2;
+	case MAP_BLOCK_FOOD:  return BATCH_FOOD;
+	case MAP_BLOCK_WALL:  return BATCH_WALL;
+	default:              return BATCH_SNAKE;
+	}
+}
+
+static void
+cache_draw_block(size_t row, size_t col)
+{
+	batch_add(&batches[block_batch(row, col)],
+			col % cache.n_cols * cache.block_size,
+			row % cache.n_rows * cache.block_size, cache.block_size);
+}
+
+static void
+cache_draw_area(size_t row_begin, size_t row_end,
+		size_t col_begin, size_t col_end)
+{
+	size_t row, col;
+
+	for (row = row_begin; row < row_end; ++row)
+		for (col = col_begin; col < col_end; ++col)
+			cache_draw_block(row, col);
+}
+
+static size_t
+min_size(size_t a, size_t b)
+{
+	return a < b ? a : b;
+}
+
+static size_t
+max_size(size_t a, size_t b)
+{
+	return a > b ? a : b;
+}
+
+/* copies the view from the cache to the window, in up to four pieces */
+static void
+blit(void)
+{
+	long map_x1, map_x2, map_y1, map_y2;
+	long x, y, src_x, src_y, w, h;
+	long cache_width, cache_height;
 
-	block_size = 20 + (zoom < -18 ? -18 : zoom);
-	map_x1 = -((map.head_col * block_size) -  (width - block_size) / 2);
-	map_y1 = -((map.head_row * block_size) - (height - block_size) / 2);
-	map_x2 = map_x1 + map.n_cols * block_size;
-	map_y2 = map_y1 + map.n_rows * block_size;
+	map_x1 = VIEW_X(&view, view.col_begin);
+	map_y1 = VIEW_Y(&view, view.row_begin);
+	map_x2 = VIEW_X(&view, view.col_end);
+	map_y2 = VIEW_Y(&view, view.row_end);
 
+	/* the parts of the window not covered by the map */
 	if (map_x1 > 0)
 		xcb_clear_area(conn, 0, window, 0, 0, map_x1, height);
 	if (map_y1 > 0)
 		xcb_clear_area(conn, 0, window, 0, 0, width, map_y1);
-	if (map_x2 < width)
+	if (map_x2 < (long)(width))
 		xcb_clear_area(conn, 0, window, map_x2, 0, width - map_x2, height);
-	if (map_y2 < height)
+	if (map_y2 < (long)(height))
 		xcb_clear_area(conn, 0, window, 0, map_y2, width, height - map_y2);
 
-	MAP_FOR_EACH_BLOCK(&map, row, col, block) {
-		switch (block) {
-		case MAP_BLOCK_SPACE:
-			gc = gc_space[(row + col) % 2];
-			break;
-		case MAP_BLOCK_FOOD:
-			gc = gc_food;
-			break;
-		case MAP_BLOCK_WALL:
-			gc = gc_wall;
-			break;
-		case MAP_BLOCK_SNAKE_UP:
-		case MAP_BLOCK_SNAKE_LEFT:
-		case MAP_BLOCK_SNAKE_RIGHT:
-		case MAP_BLOCK_SNAKE_DOWN:
-			gc = gc_snake;
-			break;
+	if (map_x1 < 0) map_x1 = 0;
+	if (map_y1 < 0) map_y1 = 0;
+	if (map_x2 > (long)(width)) map_x2 = width;
+	if (map_y2 > (long)(height)) map_y2 = height;
+
+	cache_width = cache.n_cols * cache.block_size;
+	cache_height = cache.n_rows * cache.block_size;
+
+	for (y = map_y1; y < map_y2; y += h) {
+		src_y = (y - view.y) % cache_height;
+		h = cache_height - src_y;
+		if (h > map_y2 - y)
+			h = map_y2 - y;
+		for (x = map_x1; x < map_x2; x += w) {
+			src_x = (x - view.x) % cache_width;
+			w = cache_width - src_x;
+			if (w > map_x2 - x)
+				w = map_x2 - x;
+			xcb_copy_area(conn, cache.pixmap, window, gc_copy,
+					src_x, src_y, x, y, w, h);
 		}
-
-		xcb_poly_fill_rectangle(
-			conn,
-			window,
-			gc,
-			1,
-			&(const xcb_rectangle_t) {
-				.x = map_x1 + col * block_size,
-				.y = map_y1 + row * block_size,
-				.width = block_size,
-				.height = block_size
-			}
-		);
 	}
 
 	xcb_flush(conn);
 }
 
+/* rasterizes the first line of each block row and copies it to the rest */
+static bool
+shm_render(void)
+{
+	long x, x1, x2, y, y1, y2, top, bottom;
+	uint32_t *line, color;
+	size_t row, col;
+
+	if ((shm.width != width || shm.height != height) && !shm_resize())
+		return false;
+
+	/* wait until the server is done reading the previous frame */
+	if (shm.busy) {
+		free(xcb_get_input_focus_reply(conn, xcb_get_input_focus(conn), NULL));
+		shm.busy = false;
+	}
+
+	x1 = VIEW_X(&view, view.col_begin) < 0 ? 0 : VIEW_X(&view, view.col_begin);
+	y1 = VIEW_Y(&view, view.row_begin) < 0 ? 0 : VIEW_Y(&view, view.row_begin);
+	x2 = VIEW_X(&view, view.col_end) > (long)(width) ?
+		(long)(width) : VIEW_X(&view, view.col_end);
+	y2 = VIEW_Y(&view, view.row_end) > (long)(height) ?
+		(long)(height) : VIEW_Y(&view, view.row_end);
+
+	/* the parts of the window not covered by the map */
+	memset(shm.pixels, 0, y1 * width * 4);
+	memset(shm.pixels + y2 * width, 0, (height - y2) * width * 4);
+
+	for (row = view.row_begin; row < view.row_end; ++row) {
+		top = VIEW_Y(&view, row) < y1 ? y1 : VIEW_Y(&view, row);
+		bottom = VIEW_Y(&view, row + 1) > y2 ? y2 : VIEW_Y(&view, row + 1);
+		line = shm.pixels + top * width;
+
+		for (x = 0; x < x1; ++x)
+			line[x] = 0;
+
+		for (col = view.col_begin; col < view.col_end; ++col) {
+			color = batch_colors[block_batch(row, col)];
+			for (; x < x2 && x < VIEW_X(&view, col + 1); ++x)
+				line[x] = color;
+		}
+
+		for (; x < (long)(width); ++x)
+			line[x] = 0;
+
+		for (y = top + 1; y < bottom; ++y)
+			memcpy(shm.pixels + y * width, line, width * 4);
+	}
+
+	shm_present();
+
+	return true;
+}
+
+static void
+cache_render(void)
+{
+	size_t mid_begin, mid_end;
+	int i;
+
+	if (cache.pixmap == XCB_NONE || cache.block_size != view.block_size ||
+			cache.n_cols != width / view.block_size + 2 ||
+			cache.n_rows != height / view.block_size + 2)
+		cache_reset(view.block_size);
+
+	if (map->all_changed)
+		cache.row_begin = cache.row_end = cache.col_begin = cache.col_end = 0;
+
+	/* blocks that changed and were already in the cache */
+	MAP_FOR_EACH_CHANGED_BLOCK(map, change, row, col)
+		if (cache_contains(row, col) && view_contains(&view, row, col))
+			cache_draw_block(row, col);
+
+	/* rows above and below the cached ones, then columns at both sides */
+	mid_begin = max_size(view.row_begin, cache.row_begin);
+	mid_end = min_size(view.row_end, cache.row_end);
+
+	if (mid_begin >= mid_end)
+		mid_begin = mid_end = view.row_end;
+
+	cache_draw_area(view.row_begin, mid_begin, view.col_begin, view.col_end);
+	cache_draw_area(mid_end, view.row_end, view.col_begin, view.col_end);
+	cache_draw_area(mid_begin, mid_end, view.col_begin,
+			max_size(view.col_begin, min_size(view.col_end, cache.col_begin)));
+	cache_draw_area(mid_begin, mid_end,
+			min_size(view.col_end, max_size(view.col_begin, cache.col_end)),
+			view.col_end);
+
+	cache.row_begin = view.row_begin;
+	cache.row_end = view.row_end;
+	cache.col_begin = view.col_begin;
+	cache.col_end = view.col_end;
+
+	for (i = 0; i < BATCH_COUNT; ++i)
+		batch_flush(&batches[i]);
+
+	blit();
+}
+
+static void
+render_map(void)
+{
+	view_update(&view, map, width, height, 20 + (zoom < -18 ? -18 : zoom),
+			map->snakes[0].head_row, map->snakes[0].head_col);
+
+	if (!shm.enabled || !shm_render())
+		cache_render();
+
+	/* the export copies the blocks in the change log */
+	export_publish(&export, map, score);
+	map_clear_changes(map);
+}
+
 static void
 h_client_message(xcb_client_message_event_t *ev)
 {
@@ -225,7 +595,12 @@ h_client_message(xcb_client_message_event_t *ev)
 static void
 h_expose(xcb_expose_event_t *ev)
 {
-	render_map();
+	(void) ev;
+
+	if (shm.enabled)
+		shm_present();
+	else
+		blit();
 }
 
 static void
@@ -245,12 +620,12 @@ h_key_press(xcb_key_press_event_t *ev)
 	case XKB_KEY_space: paused = !paused; break;
 	}
 
-	// FIXME: pressing j and then l should move
-	//        the snake down and in the next game frame
-	//        move the snake to the right
-	if (dir != MAP_BLOCK_INVALID) {
+	/* queued, so pressing j and then l within one tick moves the snake
+	   down and then right on the next one. turns come from the replay
+	   when playing one back */
+	if (dir != MAP_BLOCK_INVALID && NULL == play_fp) {
 		paused = false;
-		map_set_snake_direction(&map, dir);
+		map_queue_direction(map, dir, loop_now());
 	}
 }
 
@@ -261,6 +636,8 @@ h_button_press(xcb_button_press_event_t *ev)
 	case XCB_BUTTON_INDEX_4: zoom += 1; break;
 	case XCB_BUTTON_INDEX_5: zoom -= 1; break;
 	}
+
+	redraw = true;
 }
 
 static void
@@ -271,6 +648,7 @@ h_configure_notify(xcb_configure_notify_event_t *ev)
 
 	width = ev->width;
 	height = ev->height;
+	redraw = true;
 }
 
 static void
@@ -280,57 +658,206 @@ h_mapping_notify(xcb_mapping_notify_event_t *ev)
 		xcb_refresh_keyboard_mapping(ksyms, ev);
 }
 
+static void
+handle_event(xcb_generic_event_t *ev)
+{
+	switch (ev->response_type & ~0x80) {
+	case XCB_CLIENT_MESSAGE:    h_client_message((void *)(ev)); break;
+	case XCB_EXPOSE:            h_expose((void *)(ev)); break;
+	case XCB_KEY_PRESS:         h_key_press((void *)(ev)); break;
+	case XCB_BUTTON_PRESS:      h_button_press((void *)(ev)); break;
+	case XCB_CONFIGURE_NOTIFY:  h_configure_notify((void *)(ev)); break;
+	case XCB_MAPPING_NOTIFY:    h_mapping_notify((void *)(ev)); break;
+	}
+
+	free(ev);
+}
+
+/* the timer only runs along with the game, so that a paused game sleeps
+   in poll until the next event */
+static void
+sync_timer(struct loop *loop)
+{
+	if (paused)
+		loop_pause(loop);
+	else
+		loop_resume(loop);
+}
+
+/* loads the next game of the replay being played back onto the map, which
+   must be the size of the games. returns 0 at the end of the replay */
+static int
+next_game(void)
+{
+	int ret;
+
+	replay_free_game(&game);
+
+	if ((ret = replay_read_game(play_fp, &game)) <= 0)
+		return ret;
+
+	if (game.map->n_rows != map->n_rows ||
+			game.map->n_cols != map->n_cols ||
+			replay_start(&game, map) < 0)
+		return -1;
+
+	return 1;
+}
+
 int
 main(int argc, char **argv)
 {
 	xcb_generic_event_t *ev;
 	enum map_snake_state state;
+	FILE *replay_fp = NULL;
+	struct loop loop;
+	struct pollfd fds[2];
+	const char *export_name = NULL;
+	size_t turn = 0;
+	int ticks, opt, play_ret = 1;
+
+	while ((opt = getopt(argc, argv, "e:r:")) != -1) {
+		switch (opt) {
+		case 'e': export_name = optarg; break;
+		case 'r':
+			if (NULL == (play_fp = fopen(optarg, "rb")))
+				goto usage;
+			break;
+		default: goto usage;
+		}
+	}
 
-	/* seed rand with the current process id */
-	srand((unsigned int)(getpid()));
+	if (NULL != play_fp) {
+		/* playing back a replay, which holds the maps of its games */
+		if (optind != argc || replay_read_game(play_fp, &game) <= 0)
+			goto usage;
+
+		if (NULL == (map = map_create(game.map->n_rows, game.map->n_cols)) ||
+				replay_start(&game, map) < 0)
+			die("out of memory");
+	} else {
+		if (optind == argc ||
+				NULL == (level = level_load(argv[optind])) ||
+				(argc - optind > 1 &&
+				 NULL == (replay_fp = fopen(argv[optind + 1], "wb"))))
+			goto usage;
+
+		if (NULL == (map = level_new_map(level)))
+			die("out of memory");
+
+		/* seed the food generator with the current process id */
+		map_seed(map, getpid());
+	}
 
+	if (export_open(&export, export_name, map) < 0)
+		die("can't export to %s", export_name);
 
-	if (argc < 2 || map_parse_file(&map, argv[1]) < 0) {
-		fprintf(stderr, "usage: viborita_xcb [valid_map_path]\n");
-		return 1;
-	}
+	replay_begin(&replay, replay_fp, map);
 
 	create_window();
 	render_map();
 
 	paused = true;
+	loop_init(&loop, TICK_PERIOD);
+
+	fds[0].fd = xcb_get_file_descriptor(conn);
+	fds[0].events = POLLIN;
+
+	if ((fds[1].fd = loop_open_timer(&loop)) < 0)
+		die("can't create timer");
+	fds[1].events = POLLIN;
+
 	while (!should_close) {
-		while (!should_close && (ev = xcb_poll_for_event(conn))) {
-			switch (ev->response_type & ~0x80) {
-			case XCB_CLIENT_MESSAGE:    h_client_message((void *)(ev)); break;
-			case XCB_EXPOSE:            h_expose((void *)(ev)); break;
-			case XCB_KEY_PRESS:         h_key_press((void *)(ev)); break;
-			case XCB_BUTTON_PRESS:      h_button_press((void *)(ev)); break;
-			case XCB_CONFIGURE_NOTIFY:  h_configure_notify((void *)(ev)); break;
-			case XCB_MAPPING_NOTIFY:    h_mapping_notify((void *)(ev)); break;
+		sync_timer(&loop);
+		xcb_flush(conn);
+
+		/* replies read while rendering may have queued events already */
+		if (NULL != (ev = xcb_poll_for_queued_event(conn)))
+			handle_event(ev);
+		else if (poll(fds, 2, -1) < 0 && errno != EINTR)
+			die("poll failed");
+
+		while (!should_close && (ev = xcb_poll_for_event(conn)))
+			handle_event(ev);
+
+		if (xcb_connection_has_error(conn))
+			die("lost connection to the X server");
+
+		sync_timer(&loop);
+
+		for (ticks = loop_ticks(&loop); ticks > 0 && !paused; --ticks) {
+			redraw = true;
+
+			if (NULL == play_fp) {
+				map_advance(map, &state);
+				replay_turn(&replay, map);
+			} else if ((play_ret = replay_step(&game, map, &turn,
+							&state)) == 0) {
+				/* go on with the next game once one is over */
+				if ((play_ret = next_game()) <= 0) {
+					should_close = true;
+					break;
+				}
+				turn = 0;
+				score = 0;
+				continue;
+			} else if (play_ret < 0) {
+				should_close = true;
+				break;
 			}
 
-			free(ev);
-		}
-
-		if (!paused) {
-			map_advance(&map, &state);
 			switch (state) {
 			case MAP_SNAKE_DEAD:
-				map_parse_file(&map, argv[1]);
+				score = 0;
+				/* a replay goes on with its next game on the next
+				   tick */
+				if (NULL != play_fp)
+					break;
+				replay_end(&replay, map);
+				if (level_reset(level, map) < 0)
+					die("out of memory");
+				replay_begin(&replay, replay_fp, map);
 				paused = true;
 				break;
 			case MAP_SNAKE_EATING:
-				map_spawn_food(&map);
+				map_spawn_food(map);
+				score += 1;
+				break;
+			case MAP_SNAKE_IDLE:
 				break;
 			}
 		}
 
-		render_map();
-		usleep(66666);
+		if (redraw)
+			render_map();
+
+		redraw = false;
 	}
 
+	loop_close_timer(&loop);
+	export_close(&export);
 	destroy_window();
 
+	if (NULL != replay_fp) {
+		replay_end(&replay, map);
+		fclose(replay_fp);
+	}
+
+	if (NULL != play_fp) {
+		replay_free_game(&game);
+		fclose(play_fp);
+	}
+
+	map_destroy(map);
+	level_destroy(level);
+
+	if (play_ret < 0)
+		die("invalid replay");
+
 	return 0;
+
+usage:
+	fprintf(stderr, "usage: viborita_xcb [-e shm_name]"
+			" [-r replay_path | valid_map_path [replay_path]]\n");
+	return 1;
 }
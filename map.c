@@ -23,6 +23,29 @@
 #include <stdlib.h>
 #include "map.h"
 
+#define MAP_MIN_BODY_CAP 16
+#define MAP_MIN_JOURNAL_CAP 1024
+
+// Space blocks are counted per chunk of 64 blocks, and in a Fenwick tree
+// per group of 64 chunks, so that map_spawn_food can find the n-th one
+// without keeping an index of them.
+#define MAP_CHUNK_SHIFT 6
+#define MAP_GROUP_SHIFT 12
+#define MAP_N_CHUNKS(n_blocks) (((n_blocks) >> MAP_CHUNK_SHIFT) + 1)
+#define MAP_N_GROUPS(n_blocks) (((n_blocks) >> MAP_GROUP_SHIFT) + 1)
+
+// Where the head of a snake goes in map_advance_all.
+struct map_move
+{
+	map_pos_t target;
+	uint32_t snake;
+};
+
+// Directions are ordered up, left, down, right.
+#define MAP_OPPOSITE_DIRECTION(dir) \
+	((enum map_block_type)(((dir) - MAP_BLOCK_SNAKE_UP + 2) % 4 + \
+		MAP_BLOCK_SNAKE_UP))
+
 // Returns the numbers of rows an unparsed map has.
 static size_t __map_str_count_rows(const char *map_str)
 {
@@ -45,15 +68,586 @@ static size_t __map_str_count_columns(const char *map_str)
 	return n_cols;
 }
 
-// Copies one map to another.
-void map_copy(const struct map *from, struct map *to)
+// Computes the block next to (row, col) in the given direction.
+static int __map_step(const struct map *map, size_t row, size_t col,
+		enum map_block_type dir, size_t *next_row, size_t *next_col)
+{
+	switch (dir)
+	{
+		case MAP_BLOCK_SNAKE_UP:    if (row == 0) return -1; row -= 1; break;
+		case MAP_BLOCK_SNAKE_DOWN:  row += 1; break;
+		case MAP_BLOCK_SNAKE_LEFT:  if (col == 0) return -1; col -= 1; break;
+		case MAP_BLOCK_SNAKE_RIGHT: col += 1; break;
+		default: return -1;
+	}
+
+	if (!map_contains(map, row, col))
+		return -1;
+
+	*next_row = row;
+	*next_col = col;
+
+	return 0;
+}
+
+// Tells whether moving the head of a snake in the given direction would
+// go back into the block right behind it.
+static int __map_turns_back(const struct map *map,
+		const struct map_snake *snake, enum map_block_type dir)
+{
+	size_t next_row, next_col;
+
+	return snake->body_len > 1 &&
+		__map_step(map, snake->head_row, snake->head_col, dir,
+				&next_row, &next_col) == 0 &&
+		MAP_SNAKE_BLOCK(snake, snake->body_len - 2) ==
+			MAP_POS(map, next_row, next_col);
+}
+
+// Remembers the old value of a byte of the grid about to be written. Once
+// the journal would take more bytes than map_copy writes for the grid,
+// it stops recording and map_rewind falls back to map_copy.
+static void __map_log(struct map *map, size_t index, uint8_t old)
 {
-	memcpy(to, from, sizeof(struct map));
+	struct map_undo *journal;
+	size_t cap, max_cap;
+
+	if (!map->journaling)
+		return;
+
+	if (map->journal_len == map->journal_cap)
+	{
+		max_cap = map_grid_size(map) / sizeof(*journal);
+		cap = map->journal_cap ? map->journal_cap * 2 : MAP_MIN_JOURNAL_CAP;
+
+		if (cap > max_cap)
+			cap = max_cap;
+
+		if (map->journal_len >= cap ||
+				NULL == (journal = realloc(map->journal,
+						cap * sizeof(*journal))))
+		{
+			map->journaling = 0;
+			return;
+		}
+
+		map->journal = journal;
+		map->journal_cap = cap;
+	}
+
+	map->journal[map->journal_len].index = index;
+	map->journal[map->journal_len].old = old;
+	map->journal_len += 1;
+}
+
+// Stores a block into its nibble of the packed grid.
+static void __map_write(struct map *map, map_pos_t pos,
+		enum map_block_type bt)
+{
+	unsigned int shift = pos % 2 * 4;
+	__map_log(map, pos / 2, map->blocks[pos / 2]);
+	map->blocks[pos / 2] = (map->blocks[pos / 2] & ~(0xf << shift)) |
+		(bt << shift);
+}
+
+// Adds delta to the number of space blocks around pos.
+static void __map_count_free(struct map *map, map_pos_t pos, int delta)
+{
+	size_t n_groups = MAP_N_GROUPS(map->n_rows * map->n_cols);
+
+	map->free_chunks[pos >> MAP_CHUNK_SHIFT] += delta;
+	for (size_t i = (pos >> MAP_GROUP_SHIFT) + 1; i <= n_groups; i += i & -i)
+		map->free_tree[i] += delta;
+	map->n_free_blocks += delta;
+}
+
+// Records a block in the change list.
+static void __map_touch(struct map *map, map_pos_t pos)
+{
+	if (map->n_changes == MAP_MAX_CHANGES)
+		map->all_changed = 1;
+	else
+		map->changes[map->n_changes++] = pos;
+}
+
+// Writes a block keeping the count of space blocks up to date.
+static void __map_put(struct map *map, size_t row, size_t col,
+		enum map_block_type bt)
+{
+	enum map_block_type old;
+	map_pos_t pos;
+
+	pos = MAP_POS(map, row, col);
+	old = MAP_BLOCK_AT(map, row, col);
+
+	if (old == bt)
+		return;
+
+	__map_touch(map, pos);
+
+	if (old == MAP_BLOCK_SPACE)
+		__map_count_free(map, pos, -1);
+	else if (bt == MAP_BLOCK_SPACE)
+		__map_count_free(map, pos, 1);
+
+	__map_write(map, pos, bt);
+}
+
+// Counts the space blocks of the grid.
+static void __map_build_free_blocks(struct map *map)
+{
+	size_t n_blocks = map->n_rows * map->n_cols;
+	size_t n_groups = MAP_N_GROUPS(n_blocks), j;
+
+	memset(map->free_tree, 0, (n_groups + 1) * sizeof(*map->free_tree));
+	memset(map->free_chunks, 0,
+			MAP_N_CHUNKS(n_blocks) * sizeof(*map->free_chunks));
+	map->n_free_blocks = 0;
+
+	MAP_FOR_EACH_BLOCK(map, row, col, block)
+	{
+		if (block != MAP_BLOCK_SPACE)
+			continue;
+		map->free_chunks[MAP_POS(map, row, col) >> MAP_CHUNK_SHIFT] += 1;
+		map->free_tree[(MAP_POS(map, row, col) >> MAP_GROUP_SHIFT) + 1] += 1;
+		map->n_free_blocks += 1;
+	}
+
+	// Turns the count of each group into the sums of the tree.
+	for (size_t i = 1; i <= n_groups; ++i)
+		if ((j = i + (i & -i)) <= n_groups)
+			map->free_tree[j] += map->free_tree[i];
+}
+
+// Finds the n-th space block of the grid, in row-major order. The group
+// holding it is found in the tree in O(log n_blocks), then at most 64
+// chunk counts and 64 blocks are scanned.
+static map_pos_t __map_find_free_block(const struct map *map, size_t n)
+{
+	size_t n_blocks = map->n_rows * map->n_cols;
+	size_t n_groups = MAP_N_GROUPS(n_blocks), group = 0, step;
+	const uint8_t *chunk;
+	map_pos_t pos;
+
+	for (step = 1; step * 2 <= n_groups; step *= 2)
+		;
+
+	for (; step != 0; step /= 2)
+	{
+		if (group + step <= n_groups && map->free_tree[group + step] <= n)
+		{
+			group += step;
+			n -= map->free_tree[group];
+		}
+	}
+
+	pos = group << MAP_GROUP_SHIFT;
+
+	for (chunk = map->free_chunks + (pos >> MAP_CHUNK_SHIFT);
+			n >= *chunk; n -= *chunk++)
+		pos += 1 << MAP_CHUNK_SHIFT;
+
+	for (;; ++pos)
+	{
+		assert(pos < n_blocks);
+		if ((map->blocks[pos / 2] >> (pos % 2 * 4) & 0xf) ==
+				MAP_BLOCK_SPACE && n-- == 0)
+			return pos;
+	}
+}
+
+// Copies the body of a snake into a buffer, starting from the tail.
+static void __map_body_unwrap(const struct map_snake *snake, map_pos_t *out)
+{
+	size_t n_before_wrap = snake->body_cap - snake->body_start;
+
+	if (n_before_wrap >= snake->body_len)
+	{
+		memcpy(out, snake->body + snake->body_start,
+				snake->body_len * sizeof(map_pos_t));
+		return;
+	}
+
+	memcpy(out, snake->body + snake->body_start,
+			n_before_wrap * sizeof(map_pos_t));
+	memcpy(out + n_before_wrap, snake->body,
+			(snake->body_len - n_before_wrap) * sizeof(map_pos_t));
+}
+
+// Makes room for at least cap blocks in the body of a snake.
+static int __map_body_reserve(struct map_snake *snake, size_t cap)
+{
+	map_pos_t *body;
+
+	if (cap <= snake->body_cap)
+		return 0;
+
+	if (cap < snake->body_cap * 2)
+		cap = snake->body_cap * 2;
+
+	if (NULL == (body = malloc(cap * sizeof(map_pos_t))))
+		return -1;
+
+	__map_body_unwrap(snake, body);
+	free(snake->body);
+
+	snake->body = body;
+	snake->body_cap = cap;
+	snake->body_start = 0;
+
+	return 0;
+}
+
+// Appends a block to the head of a snake.
+static int __map_body_push(const struct map *map, struct map_snake *snake,
+		size_t row, size_t col)
+{
+	if (__map_body_reserve(snake, snake->body_len + 1) < 0)
+		return -1;
+
+	MAP_SNAKE_BLOCK(snake, snake->body_len) = MAP_POS(map, row, col);
+	snake->body_len += 1;
+	snake->head_row = row;
+	snake->head_col = col;
+
+	return 0;
+}
+
+// Removes the tail block of a snake.
+static void __map_body_pop(const struct map *map, struct map_snake *snake)
+{
+	snake->body_start = (snake->body_start + 1) % snake->body_cap;
+	snake->body_len -= 1;
+	snake->tail_row = MAP_POS_ROW(map, MAP_SNAKE_BLOCK(snake, 0));
+	snake->tail_col = MAP_POS_COL(map, MAP_SNAKE_BLOCK(snake, 0));
+}
+
+// Makes room for at least n snakes in the table, and for their moves.
+static int __map_snakes_reserve(struct map *map, size_t n)
+{
+	struct map_snake *snakes;
+	struct map_move *moves;
+	size_t cap;
+
+	if (n <= map->snakes_cap)
+		return 0;
+
+	cap = n < map->snakes_cap * 2 ? map->snakes_cap * 2 : n;
+
+	if (NULL == (moves = realloc(map->moves, cap * sizeof(*moves))))
+		return -1;
+
+	map->moves = moves;
+
+	if (NULL == (snakes = realloc(map->snakes, cap * sizeof(*snakes))))
+		return -1;
+
+	map->snakes = snakes;
+	map->snakes_cap = cap;
+
+	return 0;
+}
+
+// Appends a snake without any block to the table.
+static struct map_snake *__map_snake_new(struct map *map)
+{
+	struct map_snake *snake;
+
+	if (__map_snakes_reserve(map, map->n_snakes + 1) < 0)
+		return NULL;
+
+	snake = &map->snakes[map->n_snakes];
+
+	if (NULL == (snake->body = malloc(MAP_MIN_BODY_CAP * sizeof(map_pos_t))))
+		return NULL;
+
+	snake->head_row = snake->head_col = 0;
+	snake->tail_row = snake->tail_col = 0;
+	snake->body_start = snake->body_len = 0;
+	snake->body_cap = MAP_MIN_BODY_CAP;
+	snake->state = MAP_SNAKE_IDLE;
+	snake->inputs_start = snake->n_inputs = 0;
+	snake->turn.dir = MAP_BLOCK_INVALID;
+	map->n_snakes += 1;
+
+	return snake;
+}
+
+// Gives a map the same snakes as another one, without their turns.
+static int __map_copy_snakes(const struct map *from, struct map *to)
+{
+	const struct map_snake *src;
+	struct map_snake *dst;
+
+	while (to->n_snakes > from->n_snakes)
+		free(to->snakes[--to->n_snakes].body);
+
+	while (to->n_snakes < from->n_snakes)
+		if (NULL == __map_snake_new(to))
+			return -1;
+
+	for (size_t i = 0; i < from->n_snakes; ++i)
+	{
+		src = &from->snakes[i];
+		dst = &to->snakes[i];
+
+		if (__map_body_reserve(dst, src->body_len) < 0)
+			return -1;
+
+		__map_body_unwrap(src, dst->body);
+
+		dst->head_row = src->head_row;
+		dst->head_col = src->head_col;
+		dst->tail_row = src->tail_row;
+		dst->tail_col = src->tail_col;
+		dst->body_start = 0;
+		dst->body_len = src->body_len;
+		dst->state = src->state;
+		dst->inputs_start = dst->n_inputs = 0;
+		dst->turn.dir = MAP_BLOCK_INVALID;
+	}
+
+	return 0;
+}
+
+// Counts the snake blocks pointing at (row, col).
+static int __map_count_prev_blocks(const struct map *map, size_t row,
+		size_t col)
+{
+	return (col > 0 &&
+			MAP_BLOCK_AT(map, row, col - 1) == MAP_BLOCK_SNAKE_RIGHT) +
+		(col + 1 < map->n_cols &&
+			MAP_BLOCK_AT(map, row, col + 1) == MAP_BLOCK_SNAKE_LEFT) +
+		(row > 0 &&
+			MAP_BLOCK_AT(map, row - 1, col) == MAP_BLOCK_SNAKE_DOWN) +
+		(row + 1 < map->n_rows &&
+			MAP_BLOCK_AT(map, row + 1, col) == MAP_BLOCK_SNAKE_UP);
+}
+
+// Walks every snake from its tail, the block no other one points at, up
+// to its head, adding the snakes to the table in the order their tails
+// are found. A block pointed at by two others can't tell which one is
+// its body, so such maps are rejected, as are loops without a tail.
+static int __map_build_snakes(struct map *map)
+{
+	struct map_snake *snake;
+	size_t n_snake_blocks = 0, n_walked = 0, row, col;
+
+	MAP_FOR_EACH_BLOCK(map, tail_row, tail_col, block)
+	{
+		if (!MAP_BLOCK_TYPE_IS_SNAKE(block))
+			continue;
+
+		n_snake_blocks += 1;
+
+		if (__map_count_prev_blocks(map, tail_row, tail_col) != 0)
+			continue;
+
+		if (NULL == (snake = __map_snake_new(map)))
+			return -1;
+
+		snake->tail_row = row = tail_row;
+		snake->tail_col = col = tail_col;
+
+		while (1)
+		{
+			if (__map_body_push(map, snake, row, col) < 0)
+				return -1;
+
+			n_walked += 1;
+
+			if (__map_step(map, row, col, MAP_BLOCK_AT(map, row, col),
+						&row, &col) < 0 ||
+					!MAP_BLOCK_TYPE_IS_SNAKE(MAP_BLOCK_AT(map, row, col)))
+				break;
+
+			if (__map_count_prev_blocks(map, row, col) > 1)
+				return -1;
+		}
+	}
+
+	if (map->n_snakes == 0 || n_walked != n_snake_blocks)
+		return -1;
+
+	return 0;
+}
+
+void map_rng_seed(struct map_rng *rng, uint64_t seed, uint64_t stream)
+{
+	rng->state = 0;
+	rng->inc = (stream << 1) | 1;
+	map_rng_next(rng);
+	rng->state += seed;
+	map_rng_next(rng);
+}
+
+uint32_t map_rng_next(struct map_rng *rng)
+{
+	uint64_t state = rng->state;
+	uint32_t xorshifted, rot;
+
+	rng->state = state * 6364136223846793005ULL + rng->inc;
+	xorshifted = ((state >> 18) ^ state) >> 27;
+	rot = state >> 59;
+
+	return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+// Returns a number in [0, bound), without the cost of a division.
+uint32_t map_rng_bounded(struct map_rng *rng, uint32_t bound)
+{
+	return ((uint64_t)(map_rng_next(rng)) * bound) >> 32;
+}
+
+void map_seed(struct map *map, uint64_t seed)
+{
+	map_rng_seed(&map->rng, seed, 0);
+}
+
+// Number of bytes taken by the grid and the counts of its space blocks,
+// which map_copy copies whole.
+size_t map_grid_size(const struct map *map)
+{
+	size_t n_blocks = map->n_rows * map->n_cols;
+
+	return (MAP_N_GROUPS(n_blocks) + 1) * sizeof(uint32_t) +
+		MAP_N_CHUNKS(n_blocks) + (n_blocks + 1) / 2;
+}
+
+struct map *map_create(size_t n_rows, size_t n_cols)
+{
+	struct map *map;
+	size_t n_blocks;
+
+	if (n_rows == 0 || n_cols == 0 || n_rows > UINT32_MAX / n_cols)
+		return NULL;
+
+	n_blocks = n_rows * n_cols;
+
+	// The grid and the space block counts share the allocation of the map.
+	map = malloc(sizeof(struct map) +
+			(MAP_N_GROUPS(n_blocks) + 1) * sizeof(uint32_t) +
+			MAP_N_CHUNKS(n_blocks) + (n_blocks + 1) / 2);
+
+	if (NULL == map)
+		return NULL;
+
+	map->free_tree = (uint32_t *)(map + 1);
+	map->free_chunks = (uint8_t *)(map->free_tree + MAP_N_GROUPS(n_blocks) + 1);
+	map->blocks = map->free_chunks + MAP_N_CHUNKS(n_blocks);
+	map->n_rows = n_rows;
+	map->n_cols = n_cols;
+	map->snakes = NULL;
+	map->n_snakes = map->snakes_cap = 0;
+	map->moves = NULL;
+	map->tick = 0;
+	map->n_changes = 0;
+	map->all_changed = 1;
+	map->journal = NULL;
+	map->journal_len = map->journal_cap = 0;
+	map->journaling = 0;
+	map_seed(map, 0);
+
+	memset(map->blocks, 0, (n_blocks + 1) / 2);
+	__map_build_free_blocks(map);
+
+	return map;
+}
+
+void map_destroy(struct map *map)
+{
+	if (NULL == map)
+		return;
+	for (size_t i = 0; i < map->n_snakes; ++i)
+		free(map->snakes[i].body);
+	free(map->snakes);
+	free(map->moves);
+	free(map->journal);
+	free(map);
+}
+
+// Copies one map to another of the same size.
+int map_copy(const struct map *from, struct map *to)
+{
+	size_t n_blocks = from->n_rows * from->n_cols;
+
+	if (from->n_rows != to->n_rows || from->n_cols != to->n_cols ||
+			__map_copy_snakes(from, to) < 0)
+		return -1;
+
+	memcpy(to->free_tree, from->free_tree,
+			(MAP_N_GROUPS(n_blocks) + 1) * sizeof(*to->free_tree));
+	memcpy(to->free_chunks, from->free_chunks, MAP_N_CHUNKS(n_blocks));
+	memcpy(to->blocks, from->blocks, (n_blocks + 1) / 2);
+
+	to->tick = from->tick;
+	to->n_free_blocks = from->n_free_blocks;
+	to->n_changes = 0;
+	to->all_changed = 1;
+	to->rng = from->rng;
+	to->journaling = 0;
+
+	return 0;
+}
+
+// Starts recording every write made to the map, so that map_rewind can
+// take it back to its current state by undoing only what changed.
+void map_journal_start(struct map *map)
+{
+	map->journaling = 1;
+	map->journal_len = 0;
+}
+
+// Takes a journaled map back to origin, the map it was copied from when
+// the journal started, and starts a new journal. The map keeps its own
+// random generator, so consecutive games do not repeat the same food.
+int map_rewind(struct map *map, const struct map *origin)
+{
+	struct map_rng rng = map->rng;
+	struct map_undo *undo;
+	size_t n_blocks = map->n_rows * map->n_cols;
+	unsigned int shift;
+	int was_space, is_space;
+
+	if (!map->journaling)
+	{
+		if (map_copy(origin, map) < 0)
+			return -1;
+		map->rng = rng;
+		map_journal_start(map);
+		return 0;
+	}
+
+	if (__map_copy_snakes(origin, map) < 0)
+		return -1;
+
+	for (undo = map->journal + map->journal_len; undo-- != map->journal; )
+	{
+		for (map_pos_t pos = undo->index * 2;
+				pos < undo->index * 2 + 2 && pos < n_blocks; ++pos)
+		{
+			shift = pos % 2 * 4;
+			was_space = (map->blocks[undo->index] >> shift & 0xf) ==
+				MAP_BLOCK_SPACE;
+			is_space = (undo->old >> shift & 0xf) == MAP_BLOCK_SPACE;
+			if (was_space != is_space)
+				__map_count_free(map, pos, is_space ? 1 : -1);
+		}
+		map->blocks[undo->index] = undo->old;
+	}
+
+	map->tick = origin->tick;
+	map->n_changes = 0;
+	map->all_changed = 1;
+	map->journal_len = 0;
+
+	return 0;
 }
 
 // Parses a map from a string.
-int map_parse(struct map *map, const char *map_str)
+struct map *map_parse(const char *map_str)
 {
+	struct map *map;
 	size_t row = 0, col = 0;
 	char block_char;
 	enum map_block_type block_type;
@@ -61,29 +655,26 @@ int map_parse(struct map *map, const char *map_str)
 	size_t n_rows = __map_str_count_rows(map_str);
 	size_t n_cols = __map_str_count_columns(map_str);
 
-	if (n_rows == 0 || n_rows > MAX_ROWS ||
-			n_cols == 0 || n_cols > MAX_COLS)
-		return -1;
-
-	memset(map->map, 0, sizeof(map->map));
-
-	map->n_cols = n_cols;
-	map->n_rows = n_rows;
+	if (NULL == (map = map_create(n_rows, n_cols)))
+		return NULL;
 
 	while (1) switch ((block_char = *map_str++))
 	{
 		case '\0':
-			if (col != n_cols && col != 0 ||
-				map_find_snake_head(map, &map->head_row, &map->head_col) < 0 ||
-				map_find_snake_tail(map, &map->tail_row, &map->tail_col) < 0)
+			if ((col != n_cols && col != 0) ||
+				__map_build_snakes(map) < 0)
 			{
-				return -1;
+				map_destroy(map);
+				return NULL;
 			}
-			map->dir = map->map[map->head_row][map->head_col];
-			return 0;
+			__map_build_free_blocks(map);
+			return map;
 		case '\n':
 			if (col != n_cols)
-				return -1;
+			{
+				map_destroy(map);
+				return NULL;
+			}
 			col = 0;
 			row += 1;
 			break;
@@ -92,28 +683,33 @@ int map_parse(struct map *map, const char *map_str)
 			if (col >= n_cols || row >= n_rows ||
 					block_type == MAP_BLOCK_INVALID)
 			{
-				return -1;
+				map_destroy(map);
+				return NULL;
 			}
 
-			map->map[row][col] = block_type;
+			__map_write(map, MAP_POS(map, row, col), block_type);
 			col++;
 			break;
 	}
 
-	return 0;
+	return map;
 }
 
-int map_parse_file(struct map *map, const char *path)
+struct map *map_parse_file(const char *path)
 {
 	// Helper fn to get file contents.
-	extern int dump_file_cts(const char *, size_t, char *);
+	extern char *dump_file_cts(const char *);
 
-	char map_str[MAX_MAP_STR_LEN + 1 /* NUL char */];
+	struct map *map;
+	char *map_str;
 
-	if (dump_file_cts(path, sizeof(map_str), map_str) < 0)
-		return -1;
+	if (NULL == (map_str = dump_file_cts(path)))
+		return NULL;
+
+	map = map_parse(map_str);
+	free(map_str);
 
-	return map_parse(map, map_str);
+	return map;
 }
 
 int map_stringify(const struct map *map, size_t max_size, char *str)
@@ -125,7 +721,7 @@ int map_stringify(const struct map *map, size_t max_size, char *str)
 
 	for (size_t row = 0; row < map->n_rows; ++row, *str++ = '\n')
 		for (size_t col = 0; col < map->n_cols; ++col)
-				*str++ = MAP_BLOCK_TYPE_TO_CHAR(map->map[row][col]);
+				*str++ = MAP_BLOCK_TYPE_TO_CHAR(MAP_BLOCK_AT(map, row, col));
 
 	*str = '\0';
 
@@ -145,7 +741,7 @@ int map_get(const struct map *map, size_t row, size_t col,
 {
 	if (!map_contains(map, row, col))
 		return 0;
-	*bt = map->map[row][col];
+	*bt = MAP_BLOCK_AT(map, row, col);
 	return 0;
 }
 
@@ -153,20 +749,24 @@ int map_set(struct map *map, size_t row, size_t col, enum map_block_type bt)
 {
 	if (!map_contains(map, row, col))
 		return 0;
-	map->map[row][col] = bt;
+	__map_put(map, row, col, bt);
 	return 0;
 }
 
 int map_find_snake_prev_block(struct map *map, size_t row, size_t col,
 		size_t *prev_row, size_t *prev_col)
 {
-	if (col>0 && map->map[row][col-1] == MAP_BLOCK_SNAKE_RIGHT)
+	if (col>0 &&
+			MAP_BLOCK_AT(map, row, col-1) == MAP_BLOCK_SNAKE_RIGHT)
 		*prev_row = row, *prev_col = col - 1;
-	else if (col<map->n_cols-1 && map->map[row][col+1] == MAP_BLOCK_SNAKE_LEFT)
+	else if (col<map->n_cols-1 &&
+			MAP_BLOCK_AT(map, row, col+1) == MAP_BLOCK_SNAKE_LEFT)
 		*prev_row = row, *prev_col = col + 1;
-	else if (row>0 && map->map[row-1][col] == MAP_BLOCK_SNAKE_DOWN)
+	else if (row>0 &&
+			MAP_BLOCK_AT(map, row-1, col) == MAP_BLOCK_SNAKE_DOWN)
 		*prev_row = row - 1, *prev_col = col;
-	else if (row<map->n_rows-1 && map->map[row+1][col] == MAP_BLOCK_SNAKE_UP)
+	else if (row<map->n_rows-1 &&
+			MAP_BLOCK_AT(map, row+1, col) == MAP_BLOCK_SNAKE_UP)
 		*prev_row = row + 1, *prev_col = col;
 	else
 		return -1;
@@ -179,7 +779,7 @@ int map_find_snake_next_block(struct map *map, size_t row, size_t col,
 	int tmp_next_row = (int) row,
 		tmp_next_col = (int) col;
 
-	switch (map->map[row][col])
+	switch (MAP_BLOCK_AT(map, row, col))
 	{
 		case MAP_BLOCK_SNAKE_UP:    tmp_next_row -= 1; break;
 		case MAP_BLOCK_SNAKE_DOWN:  tmp_next_row += 1; break;
@@ -188,8 +788,8 @@ int map_find_snake_next_block(struct map *map, size_t row, size_t col,
 		default: return -1;
 	}
 
-	if (tmp_next_row < 0 || tmp_next_row >= map->n_rows ||
-			tmp_next_col < 0 || tmp_next_col >= map->n_cols)
+	if (tmp_next_row < 0 || (size_t) tmp_next_row >= map->n_rows ||
+			tmp_next_col < 0 || (size_t) tmp_next_col >= map->n_cols)
 		return -1;
 
 	*next_row = tmp_next_row;
@@ -200,30 +800,18 @@ int map_find_snake_next_block(struct map *map, size_t row, size_t col,
 
 int map_is_head(struct map *map, size_t row, size_t col)
 {
-	enum map_block_type block = map->map[row][col];
-	size_t next_row, next_col;
-
-	if (!MAP_BLOCK_TYPE_IS_SNAKE(block))
-		return 0;
-
-	if (map_find_snake_next_block(map, row, col, &next_row, &next_col) < 0 ||
-			!MAP_BLOCK_TYPE_IS_SNAKE(map->map[next_row][next_col]))
-		return 1;
+	for (size_t i = 0; i < map->n_snakes; ++i)
+		if (map->snakes[i].head_row == row && map->snakes[i].head_col == col)
+			return 1;
 
 	return 0;
 }
 
 int map_is_tail(struct map *map, size_t row, size_t col)
 {
-	enum map_block_type block = map->map[row][col];
-	size_t prev_row, prev_col;
-
-	if (!MAP_BLOCK_TYPE_IS_SNAKE(block))
-		return 0;
-
-	if (map_find_snake_prev_block(map, row, col, &prev_row, &prev_col) < 0 ||
-			!MAP_BLOCK_TYPE_IS_SNAKE(map->map[prev_row][prev_col]))
-		return 1;
+	for (size_t i = 0; i < map->n_snakes; ++i)
+		if (map->snakes[i].tail_row == row && map->snakes[i].tail_col == col)
+			return 1;
 
 	return 0;
 }
@@ -249,110 +837,318 @@ int map_find(struct map *map, int (*pred)(struct map *, size_t, size_t),
 
 int map_find_snake_head(struct map *map, size_t *row, size_t *col)
 {
-	if (map_find(map, map_is_head, row, col) <= 0)
+	if (map->n_snakes == 0)
 		return -1;
+	*row = map->snakes[0].head_row;
+	*col = map->snakes[0].head_col;
 	return 0;
 }
 
 int map_find_snake_tail(struct map *map, size_t *row, size_t *col)
 {
-	if (map_find(map, map_is_tail, row, col) <= 0)
+	if (map->n_snakes == 0)
 		return -1;
+	*row = map->snakes[0].tail_row;
+	*col = map->snakes[0].tail_col;
 	return 0;
 }
 
 int map_set_snake_direction(struct map *map, enum map_block_type dir)
 {
-	size_t next_head_row, next_head_col;
-	size_t head_row, head_col;
-	size_t prev_head_row, prev_head_col;
-	enum map_block_type head_block;
+	return map_snake_set_direction(map, 0, dir);
+}
+
+int map_queue_direction(struct map *map, enum map_block_type dir,
+		int64_t time)
+{
+	return map_snake_queue_direction(map, 0, dir, time);
+}
+
+int map_advance(struct map *map, enum map_snake_state *snake_state)
+{
+	if (map_advance_all(map) < 0)
+		return -1;
+
+	*snake_state = map->n_snakes > 0 ? map->snakes[0].state :
+		MAP_SNAKE_DEAD;
+
+	return 0;
+}
+
+// Adds a snake of a single block heading in dir. Returns its index.
+int map_add_snake(struct map *map, size_t row, size_t col,
+		enum map_block_type dir)
+{
+	struct map_snake *snake;
 
-	head_row = map->head_row;
-	head_col = map->head_col;
-	head_block = map->map[head_row][head_col];
+	if (!map_contains(map, row, col) || !MAP_BLOCK_TYPE_IS_SNAKE(dir) ||
+			MAP_BLOCK_AT(map, row, col) != MAP_BLOCK_SPACE)
+		return -1;
+
+	if (NULL == (snake = __map_snake_new(map)))
+		return -1;
 
-	map_find_snake_prev_block(map, head_row, head_col, &prev_head_row,
-			&prev_head_col);
-	map->map[head_row][head_col] = dir;
-	map_find_snake_next_block(map, head_row, head_col, &next_head_row,
-			&next_head_col);
+	snake->tail_row = row;
+	snake->tail_col = col;
 
-	if (prev_head_row == next_head_row &&
-			prev_head_col == next_head_col)
+	if (__map_body_push(map, snake, row, col) < 0)
 	{
-		map->map[head_row][head_col] = head_block;
+		free(snake->body);
+		map->n_snakes -= 1;
+		return -1;
+	}
+
+	__map_put(map, row, col, dir);
+
+	return map->n_snakes - 1;
+}
+
+// Clears the blocks of the dead snakes and drops them from the table,
+// keeping the order of the others.
+void map_remove_dead_snakes(struct map *map)
+{
+	struct map_snake *snake;
+	size_t n_alive = 0;
+
+	for (size_t i = 0; i < map->n_snakes; ++i)
+	{
+		snake = &map->snakes[i];
+
+		if (snake->state != MAP_SNAKE_DEAD)
+		{
+			map->snakes[n_alive++] = *snake;
+			continue;
+		}
+
+		MAP_FOR_EACH_SNAKE_BLOCK(map, snake, j, row, col)
+			__map_put(map, row, col, MAP_BLOCK_SPACE);
+
+		free(snake->body);
+	}
+
+	map->n_snakes = n_alive;
+}
+
+int map_snake_set_direction(struct map *map, size_t index,
+		enum map_block_type dir)
+{
+	struct map_snake *snake;
+
+	if (index >= map->n_snakes || !MAP_BLOCK_TYPE_IS_SNAKE(dir))
+		return -1;
+
+	snake = &map->snakes[index];
+
+	if (snake->state == MAP_SNAKE_DEAD || __map_turns_back(map, snake, dir))
+		return -1;
+
+	__map_put(map, snake->head_row, snake->head_col, dir);
+
+	return 0;
+}
+
+// Queues a turn for map_advance to apply, one per call. The turn is
+// checked against the one queued before it, or the direction of the
+// head when there is none, so turning back into the snake or repeating
+// the current direction does not use up a tick.
+int map_snake_queue_direction(struct map *map, size_t index,
+		enum map_block_type dir, int64_t time)
+{
+	enum map_block_type last;
+	struct map_snake *snake;
+	struct map_input *input;
+
+	if (index >= map->n_snakes || !MAP_BLOCK_TYPE_IS_SNAKE(dir))
+		return -1;
+
+	snake = &map->snakes[index];
+
+	if (snake->state == MAP_SNAKE_DEAD || snake->n_inputs == MAP_MAX_INPUTS)
 		return -1;
+
+	if (snake->n_inputs == 0)
+	{
+		last = MAP_BLOCK_AT(map, snake->head_row, snake->head_col);
+		if (dir == last || __map_turns_back(map, snake, dir))
+			return -1;
+	}
+	else
+	{
+		last = snake->inputs[(snake->inputs_start + snake->n_inputs - 1) %
+			MAP_MAX_INPUTS].dir;
+		if (dir == last || (snake->body_len > 1 &&
+					dir == MAP_OPPOSITE_DIRECTION(last)))
+			return -1;
 	}
 
+	input = &snake->inputs[(snake->inputs_start + snake->n_inputs) %
+		MAP_MAX_INPUTS];
+	input->dir = dir;
+	input->time = time;
+	snake->n_inputs += 1;
+
 	return 0;
 }
 
-int map_advance(struct map *map, enum map_snake_state *snake_state)
+static int __map_compare_moves(const void *a, const void *b)
 {
-	size_t head_row, head_col;
-	size_t head_next_row, head_next_col;
-	size_t tail_row, tail_col;
+	const struct map_move *ma = a, *mb = b;
+
+	if (ma->target != mb->target)
+		return (ma->target > mb->target) - (ma->target < mb->target);
 
-	head_row = map->head_row;
-	head_col = map->head_col;
-	tail_row = map->tail_row;
-	tail_col = map->tail_col;
+	return (ma->snake > mb->snake) - (ma->snake < mb->snake);
+}
+
+// Moves the head of a snake into (row, col), leaving the tail behind
+// unless it is eating.
+static int __map_move_snake(struct map *map, struct map_snake *snake,
+		size_t row, size_t col)
+{
+	size_t head_row = snake->head_row, head_col = snake->head_col;
 
-	// Check if the snake goes outside the map.
-	if (map_find_snake_next_block(map, head_row, head_col,
-				&head_next_row, &head_next_col) < 0)
+	if (__map_body_push(map, snake, row, col) < 0)
+		return -1;
+
+	__map_put(map, row, col, MAP_BLOCK_AT(map, head_row, head_col));
+
+	// The old head and the new tail keep their block but change their
+	// role in the snake, which matters to sprite based renderers.
+	__map_touch(map, MAP_POS(map, head_row, head_col));
+
+	if (snake->state != MAP_SNAKE_EATING)
 	{
-		*snake_state = MAP_SNAKE_DEAD;
-		return 0;
+		__map_put(map, snake->tail_row, snake->tail_col, MAP_BLOCK_SPACE);
+		__map_body_pop(map, snake);
+		__map_touch(map, MAP_POS(map, snake->tail_row, snake->tail_col));
 	}
 
-	switch (map->map[head_next_row][head_next_col])
+	return 0;
+}
+
+// Moves every live snake one block at once. Where each one goes is
+// decided on the grid as it was before the tick, so the order of the
+// snakes does not matter: a snake dies going out of the map or into a
+// wall or any snake block, tails included, and snakes going into the
+// same block all die there. The moves are sorted by target to find
+// those, which keeps the result the same for any number of snakes.
+int map_advance_all(struct map *map)
+{
+	struct map_snake *snake;
+	struct map_move *move;
+	size_t n_moves = 0, row, col;
+
+	map->tick += 1;
+
+	for (size_t i = 0; i < map->n_snakes; ++i)
 	{
-		case MAP_BLOCK_SPACE:
-			map->map[head_next_row][head_next_col] =
-				map->map[head_row][head_col];
-			*snake_state = MAP_SNAKE_IDLE;
-			break;
-		case MAP_BLOCK_FOOD:
-			map->map[head_next_row][head_next_col] =
-				map->map[head_row][head_col];
-			*snake_state = MAP_SNAKE_EATING;
-			break;
-		default:
-			*snake_state = MAP_SNAKE_DEAD;
-			return 0;
+		snake = &map->snakes[i];
+
+		if (snake->state == MAP_SNAKE_DEAD)
+			continue;
+
+		snake->turn.dir = MAP_BLOCK_INVALID;
+
+		if (snake->n_inputs > 0)
+		{
+			if (map_snake_set_direction(map, i,
+						snake->inputs[snake->inputs_start].dir) == 0)
+				snake->turn = snake->inputs[snake->inputs_start];
+			snake->inputs_start = (snake->inputs_start + 1) % MAP_MAX_INPUTS;
+			snake->n_inputs -= 1;
+		}
+
+		if (__map_step(map, snake->head_row, snake->head_col,
+					MAP_BLOCK_AT(map, snake->head_row, snake->head_col),
+					&row, &col) < 0)
+		{
+			snake->state = MAP_SNAKE_DEAD;
+			continue;
+		}
+
+		switch (MAP_BLOCK_AT(map, row, col))
+		{
+			case MAP_BLOCK_SPACE:
+				snake->state = MAP_SNAKE_IDLE;
+				break;
+			case MAP_BLOCK_FOOD:
+				snake->state = MAP_SNAKE_EATING;
+				break;
+			default:
+				snake->state = MAP_SNAKE_DEAD;
+				continue;
+		}
+
+		move = &map->moves[n_moves++];
+		move->target = MAP_POS(map, row, col);
+		move->snake = i;
 	}
 
-	if (*snake_state != MAP_SNAKE_EATING)
+	if (n_moves > 1)
 	{
-		map_find_snake_next_block(map, tail_row, tail_col, &map->tail_row,
-				&map->tail_col);
-		map->map[tail_row][tail_col] = MAP_BLOCK_SPACE;
+		qsort(map->moves, n_moves, sizeof(*map->moves), __map_compare_moves);
+
+		for (size_t i = 0, j; i < n_moves; i = j)
+		{
+			for (j = i + 1; j < n_moves &&
+					map->moves[j].target == map->moves[i].target; ++j)
+				;
+
+			if (j - i > 1)
+				for (size_t k = i; k < j; ++k)
+					map->snakes[map->moves[k].snake].state = MAP_SNAKE_DEAD;
+		}
 	}
 
-	map->head_row = head_next_row;
-	map->head_col = head_next_col;
+	for (size_t i = 0; i < n_moves; ++i)
+	{
+		move = &map->moves[i];
+		snake = &map->snakes[move->snake];
+
+		if (snake->state == MAP_SNAKE_DEAD)
+			continue;
+
+		if (__map_move_snake(map, snake, MAP_POS_ROW(map, move->target),
+					MAP_POS_COL(map, move->target)) < 0)
+			return -1;
+	}
 
 	return 0;
 }
 
 int map_spawn_food(struct map *map)
 {
-	size_t n_space_blocks = 0;
-	MAP_FOR_EACH_BLOCK(map, row, col, block)
-		if (block == MAP_BLOCK_SPACE)
-			n_space_blocks += 1;
-	if (n_space_blocks == 0)
+	map_pos_t pos;
+
+	if (map_is_full(map))
 		return -1;
-	size_t n_food_block = rand() % n_space_blocks;
-	MAP_FOR_EACH_BLOCK(map, row, col, block)
-	{
-		if (block != MAP_BLOCK_SPACE)
-			continue;
-		if (n_food_block == 0)
-			map->map[row][col] = MAP_BLOCK_FOOD;
-		n_food_block -= 1;
-	}
+
+	pos = __map_find_free_block(map,
+			map_rng_bounded(&map->rng, map->n_free_blocks));
+	__map_put(map, MAP_POS_ROW(map, pos), MAP_POS_COL(map, pos),
+			MAP_BLOCK_FOOD);
+
 	return 0;
 }
+
+int map_is_full(const struct map *map)
+{
+	return map->n_free_blocks == 0;
+}
+
+// FNV-1a hash of the grid, to compare two maps without keeping both.
+uint32_t map_hash(const struct map *map)
+{
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < (map->n_rows * map->n_cols + 1) / 2; ++i)
+		hash = (hash ^ map->blocks[i]) * 16777619u;
+
+	return hash;
+}
+
+void map_clear_changes(struct map *map)
+{
+	map->n_changes = 0;
+	map->all_changed = 0;
+}
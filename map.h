@@ -19,10 +19,25 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
-#define MAX_COLS 100
-#define MAX_ROWS 100
-#define MAX_MAP_STR_LEN ((MAX_COLS+1)*MAX_ROWS)
+// Positions are packed as a single index into the grid.
+#define MAP_POS(m, row, col) ((map_pos_t)((row) * (m)->n_cols + (col)))
+#define MAP_POS_ROW(m, pos) ((size_t)(pos) / (m)->n_cols)
+#define MAP_POS_COL(m, pos) ((size_t)(pos) % (m)->n_cols)
+
+// Position of the i-th block of a snake, counting from its tail.
+#define MAP_SNAKE_BLOCK(s, i) \
+	((s)->body[((s)->body_start + (i)) % (s)->body_cap])
+
+// Number of changed blocks a map remembers before asking for a full redraw.
+#define MAP_MAX_CHANGES 64
+
+// Number of turns a map can hold before map_advance applies them.
+#define MAP_MAX_INPUTS 8
+
+// Size of the buffer needed by map_stringify.
+#define MAP_STR_SIZE(m) ((m)->n_rows * ((m)->n_cols + 1) + 1)
 
 #define MAP_BLOCK_TYPE_IS_SNAKE(bt) \
 	(bt == MAP_BLOCK_SNAKE_DOWN || \
@@ -49,14 +64,37 @@
 		bt == MAP_BLOCK_SNAKE_DOWN ? 'v' : \
 		bt == MAP_BLOCK_SNAKE_RIGHT ? '>' : '?')
 
+// Blocks are packed two per byte, the first one in the low nibble.
+#define MAP_BLOCK_AT(m, row, col) \
+	((enum map_block_type)(((m)->blocks[MAP_POS(m, row, col) / 2] >> \
+		(MAP_POS(m, row, col) % 2 * 4)) & 0xf))
+
 #define MAP_FOR_EACH_BLOCK(m, row, col, block) \
 	for (size_t row = 0, col = 0; row < (m)->n_rows; ++row, col = 0) \
 		for ( \
 			enum map_block_type block; \
-			col < (m)->n_cols && (block = (m)->map[row][col]) == block; \
+			col < (m)->n_cols && ((block = MAP_BLOCK_AT(m, row, col)), 1); \
 			++col \
 		) \
 
+#define MAP_FOR_EACH_SNAKE_BLOCK(m, s, i, row, col) \
+	for (size_t i = 0, row, col; \
+			i < (s)->body_len && \
+			((row = MAP_POS_ROW(m, MAP_SNAKE_BLOCK(s, i))), \
+			 (col = MAP_POS_COL(m, MAP_SNAKE_BLOCK(s, i))), 1); \
+			++i) \
+
+// Iterates the blocks changed since the last call to map_clear_changes,
+// unless all_changed is set, in which case every block must be redrawn.
+#define MAP_FOR_EACH_CHANGED_BLOCK(m, i, row, col) \
+	for (size_t i = 0, row, col; \
+			i < (m)->n_changes && \
+			((row = MAP_POS_ROW(m, (m)->changes[i])), \
+			 (col = MAP_POS_COL(m, (m)->changes[i])), 1); \
+			++i) \
+
+typedef uint32_t map_pos_t;
+
 enum map_block_type
 {
 	MAP_BLOCK_SPACE,
@@ -69,6 +107,12 @@ enum map_block_type
 	MAP_BLOCK_INVALID
 };
 
+// PCG32 generator, small enough to give every map its own.
+struct map_rng
+{
+	uint64_t state, inc;
+};
+
 enum map_snake_state
 {
 	MAP_SNAKE_DEAD,
@@ -76,18 +120,83 @@ enum map_snake_state
 	MAP_SNAKE_EATING
 };
 
-struct map
+// A turn asked for by the player, with the time it was asked at, in
+// whatever unit the caller uses.
+struct map_input
+{
+	enum map_block_type dir;
+	int64_t time;
+};
+
+struct map_snake
 {
 	size_t head_row, head_col;
 	size_t tail_row, tail_col;
+	// Ring buffer with the body, from the tail to the head.
+	map_pos_t *body;
+	size_t body_start, body_len, body_cap;
+	// Outcome of the last map_advance. Dead snakes stay where they died
+	// and no longer move.
+	enum map_snake_state state;
+	// Ring buffer of turns not applied yet, the oldest first. Each call
+	// to map_advance applies one of them, and leaves it in turn, whose
+	// dir is MAP_BLOCK_INVALID when no turn was applied.
+	struct map_input inputs[MAP_MAX_INPUTS];
+	size_t inputs_start, n_inputs;
+	struct map_input turn;
+};
+
+struct map_move;
+
+// Old value of a byte of the grid, written in the journal.
+struct map_undo
+{
+	uint32_t index;
+	uint8_t old;
+};
+
+struct map
+{
 	size_t n_cols, n_rows;
-	enum map_block_type map[MAX_COLS][MAX_ROWS];
-	enum map_block_type dir;
+	uint8_t *blocks;
+	// Every snake on the map. The functions without a snake index act
+	// on the first one, for games with a single player.
+	struct map_snake *snakes;
+	size_t n_snakes, snakes_cap;
+	// Where each snake moves to, filled by map_advance.
+	struct map_move *moves;
+	// Number of space blocks in each chunk of 64 blocks, in a Fenwick
+	// tree over the groups of 4096 blocks, 1-based, and in the whole grid.
+	uint32_t *free_tree;
+	uint8_t *free_chunks;
+	size_t n_free_blocks;
+	// Blocks written since the last map_clear_changes.
+	map_pos_t changes[MAP_MAX_CHANGES];
+	size_t n_changes;
+	int all_changed;
+	// Generator used to place food.
+	struct map_rng rng;
+	// Number of calls to map_advance since the map was parsed.
+	uint64_t tick;
+	// Old values of the writes made since map_journal_start.
+	struct map_undo *journal;
+	size_t journal_len, journal_cap;
+	int journaling;
 };
 
-void map_copy(const struct map *from, struct map *to);
-int map_parse(struct map *map, const char *map_str);
-int map_parse_file(struct map *map, const char *path);
+void map_rng_seed(struct map_rng *rng, uint64_t seed, uint64_t stream);
+uint32_t map_rng_next(struct map_rng *rng);
+uint32_t map_rng_bounded(struct map_rng *rng, uint32_t bound);
+void map_seed(struct map *map, uint64_t seed);
+
+struct map *map_create(size_t n_rows, size_t n_cols);
+void map_destroy(struct map *map);
+size_t map_grid_size(const struct map *map);
+int map_copy(const struct map *from, struct map *to);
+void map_journal_start(struct map *map);
+int map_rewind(struct map *map, const struct map *origin);
+struct map *map_parse(const char *map_str);
+struct map *map_parse_file(const char *path);
 int map_stringify(const struct map *map, size_t max_size, char *str);
 int map_contains(const struct map *map, size_t row, size_t col);
 int map_get(const struct map *map, size_t row, size_t col,
@@ -104,5 +213,18 @@ int map_find(struct map *map, int (*pred)(struct map *, size_t, size_t),
 int map_find_snake_head(struct map *map, size_t *row, size_t *col);
 int map_find_snake_tail(struct map *map, size_t *row, size_t *col);
 int map_set_snake_direction(struct map *map, enum map_block_type dir);
+int map_queue_direction(struct map *map, enum map_block_type dir,
+		int64_t time);
 int map_advance(struct map *map, enum map_snake_state *snake_state);
+int map_add_snake(struct map *map, size_t row, size_t col,
+		enum map_block_type dir);
+void map_remove_dead_snakes(struct map *map);
+int map_snake_set_direction(struct map *map, size_t index,
+		enum map_block_type dir);
+int map_snake_queue_direction(struct map *map, size_t index,
+		enum map_block_type dir, int64_t time);
+int map_advance_all(struct map *map);
 int map_spawn_food(struct map *map);
+int map_is_full(const struct map *map);
+uint32_t map_hash(const struct map *map);
+void map_clear_changes(struct map *map);
@@ -0,0 +1,162 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include "assets.h"
+
+#define BYTES_PER_LINE 16
+
+static const char *sprite_paths[] = {
+#define X(id, path) path,
+	ASSETS_SPRITES(X)
+#undef X
+};
+
+static const char *sound_paths[] = {
+#define X(id, path) path,
+	ASSETS_SOUNDS(X)
+#undef X
+};
+
+static int sprite_sizes[sizeof(sprite_paths) / sizeof(sprite_paths[0])][2];
+static Uint32 sound_sizes[sizeof(sound_paths) / sizeof(sound_paths[0])];
+
+static void
+die(const char *fmt, ...)
+{
+	va_list args;
+
+	fputs("mkassets: ", stderr);
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fputc('\n', stderr);
+	exit(1);
+}
+
+static void
+dump_bytes(const char *name, size_t index, const uint8_t *bytes, size_t size)
+{
+	size_t i;
+
+	/* sounds are read as 16 bit samples and pixels as 32 bit words */
+	printf("static const _Alignas(4) uint8_t %s_%zu[] = {", name, index);
+
+	for (i = 0; i < size; ++i)
+		printf("%s0x%02x,", i % BYTES_PER_LINE ? " " : "\n\t", bytes[i]);
+
+	printf("\n};\n\n");
+}
+
+static void
+dump_sprite(size_t index, const char *path)
+{
+	SDL_Surface *loaded, *rgba;
+	uint8_t *pixels;
+	int row;
+
+	if (NULL == (loaded = IMG_Load(path)) ||
+			NULL == (rgba = SDL_ConvertSurfaceFormat(loaded,
+					SDL_PIXELFORMAT_RGBA32, 0)))
+		die("can't load %s: %s", path, SDL_GetError());
+
+	if (NULL == (pixels = malloc(rgba->w * rgba->h * 4)))
+		die("out of memory");
+
+	/* without the padding the rows of the surface may have */
+	for (row = 0; row < rgba->h; ++row)
+		memcpy(pixels + row * rgba->w * 4,
+				(const uint8_t *)(rgba->pixels) + row * rgba->pitch,
+				rgba->w * 4);
+
+	dump_bytes("sprite", index, pixels, rgba->w * rgba->h * 4);
+	sprite_sizes[index][0] = rgba->w;
+	sprite_sizes[index][1] = rgba->h;
+
+	free(pixels);
+	SDL_FreeSurface(rgba);
+	SDL_FreeSurface(loaded);
+}
+
+/* converts the samples to the format the game opens the mixer with */
+static void
+dump_sound(size_t index, const char *path)
+{
+	SDL_AudioSpec spec;
+	SDL_AudioCVT cvt;
+	Uint8 *samples;
+	Uint32 size;
+
+	if (NULL == SDL_LoadWAV(path, &spec, &samples, &size))
+		die("can't load %s: %s", path, SDL_GetError());
+
+	if (SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq,
+				AUDIO_S16SYS, ASSETS_SOUND_CHANNELS,
+				ASSETS_SOUND_FREQUENCY) < 0)
+		die("can't convert %s: %s", path, SDL_GetError());
+
+	cvt.len = size;
+
+	if (NULL == (cvt.buf = SDL_malloc(size * cvt.len_mult)))
+		die("out of memory");
+
+	memcpy(cvt.buf, samples, size);
+	SDL_FreeWAV(samples);
+
+	if (SDL_ConvertAudio(&cvt) < 0)
+		die("can't convert %s: %s", path, SDL_GetError());
+
+	dump_bytes("sound", index, cvt.buf, cvt.len_cvt);
+	sound_sizes[index] = cvt.len_cvt;
+
+	SDL_free(cvt.buf);
+}
+
+int
+main(void)
+{
+	size_t i;
+
+	printf("/* generated by mkassets from gfx/ and sfx/, do not edit */\n\n");
+	printf("#include <stdint.h>\n#include \"assets.h\"\n\n");
+
+	for (i = 0; i < sizeof(sprite_paths) / sizeof(sprite_paths[0]); ++i)
+		dump_sprite(i, sprite_paths[i]);
+
+	for (i = 0; i < sizeof(sound_paths) / sizeof(sound_paths[0]); ++i)
+		dump_sound(i, sound_paths[i]);
+
+	printf("const struct asset_image asset_sprites[] = {\n");
+	for (i = 0; i < sizeof(sprite_paths) / sizeof(sprite_paths[0]); ++i)
+		printf("\t{ %d, %d, sprite_%zu },\n", sprite_sizes[i][0],
+				sprite_sizes[i][1], i);
+	printf("};\n\n");
+
+	printf("const struct asset_sound asset_sounds[] = {\n");
+	for (i = 0; i < sizeof(sound_paths) / sizeof(sound_paths[0]); ++i)
+		printf("\t{ %lu, sound_%zu },\n", (unsigned long)(sound_sizes[i]), i);
+	printf("};\n");
+
+	return ferror(stdout) ? 1 : 0;
+}
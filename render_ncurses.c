@@ -0,0 +1,164 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#include "map.h"
+#include "view.h"
+#include "render_ncurses.h"
+#include <ncurses.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define PAUSE_MSG "paused"
+
+enum
+{
+	PAIR_WALL = 1,
+	PAIR_FOOD,
+	PAIR_SNAKE
+};
+
+void init_colors(void)
+{
+	short bg;
+
+	if (!has_colors() || start_color() == ERR)
+		return;
+
+	bg = use_default_colors() == OK ? -1 : COLOR_BLACK;
+	init_pair(PAIR_WALL, COLOR_BLUE, bg);
+	init_pair(PAIR_FOOD, COLOR_RED, bg);
+	init_pair(PAIR_SNAKE, COLOR_GREEN, bg);
+}
+
+static chtype block_cell(enum map_block_type block)
+{
+	chtype ch = MAP_BLOCK_TYPE_TO_CHAR(block);
+
+	switch (block)
+	{
+		case MAP_BLOCK_WALL: return ch | COLOR_PAIR(PAIR_WALL);
+		case MAP_BLOCK_FOOD: return ch | COLOR_PAIR(PAIR_FOOD) | A_BOLD;
+		case MAP_BLOCK_SPACE: return ch;
+		default: return ch | COLOR_PAIR(PAIR_SNAKE) | A_BOLD;
+	}
+}
+
+static void put_cell(struct screen *screen, int y, int x, chtype ch)
+{
+	if (screen->cells[y * screen->cols + x] == ch)
+		return;
+	screen->cells[y * screen->cols + x] = ch;
+	mvaddch(y, x, ch);
+}
+
+// Moves the camera along one axis only once the head gets closer than a
+// quarter of the screen to an edge, so most ticks redraw the few blocks
+// that changed instead of scrolling the whole map. Maps that fit on the
+// screen are kept still in its middle.
+static size_t follow(size_t camera, size_t head, long n_cells,
+		size_t n_blocks)
+{
+	long margin = n_cells / 4;
+
+	if ((long)(n_blocks) <= n_cells)
+		return n_blocks / 2;
+	if ((long)(head) - (long)(camera) > margin)
+		return head - margin;
+	if ((long)(camera) - (long)(head) > margin)
+		return head + margin;
+	return camera;
+}
+
+// Draws the map on every line of the terminal but the last two.
+int draw_map(struct screen *screen, struct map *map, bool paused)
+{
+	struct view view;
+	size_t camera_row, camera_col, row, col;
+	chtype *cells;
+	int lines = LINES - 2, y, x;
+
+	if (lines < 0)
+		lines = 0;
+
+	if (lines != screen->lines || COLS != screen->cols)
+	{
+		if (NULL == (cells = realloc(screen->cells,
+						((size_t)(lines) * COLS + 1) * sizeof(chtype))))
+			return -1;
+		for (y = 0; y < lines * COLS; ++y)
+			cells[y] = ' ';
+		screen->cells = cells;
+		screen->lines = lines;
+		screen->cols = COLS;
+		screen->full = true;
+		erase();
+	}
+
+	camera_row = follow(screen->camera_row, map->snakes[0].head_row, lines,
+			map->n_rows);
+	camera_col = follow(screen->camera_col, map->snakes[0].head_col, COLS,
+			map->n_cols);
+
+	if (camera_row != screen->camera_row || camera_col != screen->camera_col)
+	{
+		screen->camera_row = camera_row;
+		screen->camera_col = camera_col;
+		screen->full = true;
+	}
+
+	view_update(&view, map, COLS, lines, 1, camera_row, camera_col);
+
+	if (screen->full || map->all_changed)
+	{
+		// Cells left or above the map give a negative row or column,
+		// which wraps around and falls outside the view as well.
+		for (y = 0; y < lines; ++y)
+		{
+			for (x = 0; x < COLS; ++x)
+			{
+				row = y - view.y;
+				col = x - view.x;
+				put_cell(screen, y, x, view_contains(&view, row, col) ?
+						block_cell(MAP_BLOCK_AT(map, row, col)) : ' ');
+			}
+		}
+	}
+	else
+	{
+		MAP_FOR_EACH_CHANGED_BLOCK(map, i, row, col)
+			if (view_contains(&view, row, col))
+				put_cell(screen, VIEW_Y(&view, row), VIEW_X(&view, col),
+						block_cell(MAP_BLOCK_AT(map, row, col)));
+	}
+
+	screen->full = false;
+	map_clear_changes(map);
+
+	// The message is not kept in the cells, so the next full redraw,
+	// which comes with unpausing, puts back what it covers.
+	if (paused && lines > 0 && COLS >= (int)sizeof(PAUSE_MSG))
+	{
+		y = lines / 2;
+		x = (COLS - (int)sizeof(PAUSE_MSG)) / 2;
+		mvaddstr(y, x, PAUSE_MSG);
+		for (size_t i = 0; i < sizeof(PAUSE_MSG) - 1; ++i)
+			screen->cells[y * COLS + x + i] = 0;
+	}
+
+	return 0;
+}
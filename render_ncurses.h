@@ -0,0 +1,38 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#pragma once
+
+#include <ncurses.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "map.h"
+
+// What was last drawn on each cell of the part of the terminal showing
+// the map, so that only the cells that differ are passed to curses.
+struct screen
+{
+	chtype *cells;
+	int lines, cols;
+	size_t camera_row, camera_col;
+	// Set when every cell has to be checked, not only changed blocks.
+	bool full;
+};
+
+void init_colors(void);
+int draw_map(struct screen *screen, struct map *map, bool paused);
@@ -0,0 +1,414 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#include "map.h"
+#include "view.h"
+#include "assets.h"
+#include "render_sdl.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_render.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MIN_QUADS 1024
+
+#define SPACE_COLOR 0x090909
+#define WALL_COLOR 0x349eeb
+
+// Size of the white area of the atlas used to draw plain rectangles.
+#define WHITE_SIZE 2
+
+void fail(const char *msg)
+{
+	fputs(msg, stderr);
+	exit(1);
+}
+
+// Pack every embedded sprite side by side into a single texture.
+void build_atlas(struct sdl_context *ctx)
+{
+	SDL_Surface *sprites[SPRITE_COUNT] = { NULL }, *atlas;
+	SDL_Rect rects[SPRITE_COUNT];
+	int width = 0, height = WHITE_SIZE;
+
+	for (int i = 0; i < SPRITE_COUNT; ++i)
+	{
+		rects[i].x = width;
+		rects[i].y = 0;
+		rects[i].w = rects[i].h = WHITE_SIZE;
+
+		if (i != SPRITE_WHITE)
+		{
+			// The surface only wraps the pixels, nothing gets copied.
+			rects[i].w = asset_sprites[i].width;
+			rects[i].h = asset_sprites[i].height;
+
+			if (NULL == (sprites[i] = SDL_CreateRGBSurfaceWithFormatFrom(
+							(void *)(asset_sprites[i].pixels),
+							rects[i].w, rects[i].h, 32, rects[i].w * 4,
+							SDL_PIXELFORMAT_RGBA32)))
+				fail("couldn't load sprite");
+		}
+
+		width += rects[i].w;
+		if (rects[i].h > height)
+			height = rects[i].h;
+	}
+
+	if (NULL == (atlas = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32,
+					SDL_PIXELFORMAT_RGBA32)))
+		fail("couldn't create atlas");
+
+	for (int i = 0; i < SPRITE_COUNT; ++i)
+	{
+		if (NULL == sprites[i])
+		{
+			SDL_FillRect(atlas, &rects[i], 0xffffffff);
+		}
+		else
+		{
+			// Copy the alpha channel as is instead of blending it.
+			SDL_SetSurfaceBlendMode(sprites[i], SDL_BLENDMODE_NONE);
+			SDL_BlitSurface(sprites[i], NULL, atlas, &rects[i]);
+			SDL_FreeSurface(sprites[i]);
+		}
+
+		ctx->uv[i][0].x = (float)rects[i].x / width;
+		ctx->uv[i][0].y = (float)rects[i].y / height;
+		ctx->uv[i][1].x = (float)(rects[i].x + rects[i].w) / width;
+		ctx->uv[i][1].y = (float)(rects[i].y + rects[i].h) / height;
+	}
+
+	// Sample the middle of the white area, away from its neighbours.
+	ctx->uv[SPRITE_WHITE][0].x = ctx->uv[SPRITE_WHITE][1].x =
+		(rects[SPRITE_WHITE].x + WHITE_SIZE / 2.0f) / width;
+	ctx->uv[SPRITE_WHITE][0].y = ctx->uv[SPRITE_WHITE][1].y =
+		(WHITE_SIZE / 2.0f) / height;
+
+	if (NULL == (ctx->atlas = SDL_CreateTextureFromSurface(ctx->renderer,
+					atlas)))
+		fail("couldn't create atlas texture");
+
+	SDL_SetTextureBlendMode(ctx->atlas, SDL_BLENDMODE_BLEND);
+	SDL_FreeSurface(atlas);
+}
+
+// Queue a quad showing a sprite, tinted by color.
+void push_quad(struct sdl_context *ctx, enum sprite sprite, int x, int y,
+		int w, int h, uint32_t color)
+{
+	SDL_Color c = {
+		.r = (color >> 16) & 0xff,
+		.g = (color >>  8) & 0xff,
+		.b = (color >>  0) & 0xff,
+		.a = 0xff
+	};
+
+	const SDL_FPoint *uv = ctx->uv[sprite];
+	SDL_Vertex *v;
+
+	if (ctx->n_quads == ctx->max_quads)
+	{
+		int max_quads = ctx->max_quads ? ctx->max_quads * 2 : MIN_QUADS;
+
+		if (NULL == (ctx->vertices = realloc(ctx->vertices,
+						4 * max_quads * sizeof(SDL_Vertex))) ||
+				NULL == (ctx->indices = realloc(ctx->indices,
+						6 * max_quads * sizeof(int))))
+			fail("out of memory");
+
+		// Two triangles per quad, the same for every frame.
+		for (int i = ctx->max_quads; i < max_quads; ++i)
+		{
+			ctx->indices[6 * i + 0] = 4 * i + 0;
+			ctx->indices[6 * i + 1] = 4 * i + 1;
+			ctx->indices[6 * i + 2] = 4 * i + 2;
+			ctx->indices[6 * i + 3] = 4 * i + 0;
+			ctx->indices[6 * i + 4] = 4 * i + 2;
+			ctx->indices[6 * i + 5] = 4 * i + 3;
+		}
+
+		ctx->max_quads = max_quads;
+	}
+
+	v = ctx->vertices + 4 * ctx->n_quads++;
+
+	v[0] = (SDL_Vertex) { { x, y }, c, { uv[0].x, uv[0].y } };
+	v[1] = (SDL_Vertex) { { x + w, y }, c, { uv[1].x, uv[0].y } };
+	v[2] = (SDL_Vertex) { { x + w, y + h }, c, { uv[1].x, uv[1].y } };
+	v[3] = (SDL_Vertex) { { x, y + h }, c, { uv[0].x, uv[1].y } };
+}
+
+void render_texture(struct sdl_context *ctx, int sprite, int x, int y,
+		int w, int h)
+{
+	if (sprite >= SPRITE_COUNT || sprite < 0)
+		fail("unknown texture id");
+
+	push_quad(ctx, sprite, x, y, w, h, 0xffffff);
+}
+
+void render_rect(struct sdl_context *ctx, int x, int y, int w, int h,
+		uint32_t color)
+{
+	push_quad(ctx, SPRITE_WHITE, x, y, w, h, color);
+}
+
+void begin_draw(struct sdl_context *ctx)
+{
+	SDL_SetRenderDrawColor(ctx->renderer, 0, 0, 0, 255);
+	SDL_RenderClear(ctx->renderer);
+}
+
+void end_draw(struct sdl_context *ctx)
+{
+	SDL_RenderGeometry(ctx->renderer, ctx->atlas, ctx->vertices,
+			4 * ctx->n_quads, ctx->indices, 6 * ctx->n_quads);
+	ctx->n_quads = 0;
+	SDL_RenderPresent(ctx->renderer);
+}
+
+// Size of what the renderer draws on, a window or an offscreen surface.
+void get_window_size(struct sdl_context *ctx, int *ww, int *wh)
+{
+	SDL_GetRendererOutputSize(ctx->renderer, ww, wh);
+}
+
+// Color of a block in the static layer.
+uint32_t static_color(enum map_block_type block, size_t row, size_t col)
+{
+	if (block == MAP_BLOCK_WALL)
+		return WALL_COLOR;
+	return SPACE_COLOR * ((row + col) % 2 == 0);
+}
+
+// Draw the background and the walls into a texture with one texel per
+// block, for render_map to scale to the block size. The map must not gain
+// or lose walls after this. Maps larger than the renderer can hold in a
+// texture are drawn block by block instead.
+void build_static_layer(struct sdl_context *ctx, const struct map *map)
+{
+	uint32_t *texels;
+
+	if (NULL != ctx->static_layer)
+		SDL_DestroyTexture(ctx->static_layer);
+
+	ctx->static_layer = SDL_CreateTexture(
+		ctx->renderer,
+		SDL_PIXELFORMAT_ARGB8888,
+		SDL_TEXTUREACCESS_STATIC,
+		map->n_cols,
+		map->n_rows
+	);
+
+	if (NULL == ctx->static_layer)
+		return;
+
+	if (NULL == (texels = malloc(map->n_rows * map->n_cols *
+					sizeof(uint32_t))))
+		fail("out of memory");
+
+	MAP_FOR_EACH_BLOCK(map, row, col, block)
+		texels[row * map->n_cols + col] = 0xff000000 |
+			static_color(block, row, col);
+
+	SDL_UpdateTexture(ctx->static_layer, NULL, texels,
+			map->n_cols * sizeof(uint32_t));
+	SDL_SetTextureScaleMode(ctx->static_layer, SDL_ScaleModeNearest);
+	free(texels);
+}
+
+void render_snake(struct sdl_context *ctx, const struct map *map,
+		const struct map_snake *snake, const struct view *view, int cz)
+{
+	enum map_block_type prev, cur;
+	int is_head, is_tail;
+
+	prev = MAP_BLOCK_INVALID;
+
+	MAP_FOR_EACH_SNAKE_BLOCK(map, snake, i, r, c)
+	{
+		int text = -1;
+
+		is_tail = i == 0;
+		is_head = i == snake->body_len - 1;
+
+		cur = MAP_BLOCK_AT(map, r, c);
+
+		if (!view_contains(view, r, c))
+		{
+			prev = cur;
+			continue;
+		}
+
+		if (is_tail) switch (cur)
+		{
+			case MAP_BLOCK_SNAKE_LEFT:
+				text = SPRITE_TAIL_LEFT;
+				break;
+			case MAP_BLOCK_SNAKE_RIGHT:
+				text = SPRITE_TAIL_RIGHT;
+				break;
+			case MAP_BLOCK_SNAKE_UP:
+				text = SPRITE_TAIL_UP;
+				break;
+			case MAP_BLOCK_SNAKE_DOWN:
+				text = SPRITE_TAIL_DOWN;
+				break;
+			default:
+				break;
+		}
+
+		if (is_head) switch (cur)
+		{
+			case MAP_BLOCK_SNAKE_LEFT:
+				text = SPRITE_HEAD_LEFT;
+				break;
+			case MAP_BLOCK_SNAKE_RIGHT:
+				text = SPRITE_HEAD_RIGHT;
+				break;
+			case MAP_BLOCK_SNAKE_UP:
+				text = SPRITE_HEAD_UP;
+				break;
+			case MAP_BLOCK_SNAKE_DOWN:
+				text = SPRITE_HEAD_DOWN;
+				break;
+			default:
+				break;
+		}
+
+		if (!is_head && !is_tail)
+		{
+			if (cur == prev)
+			{
+				switch (cur)
+				{
+					case MAP_BLOCK_SNAKE_DOWN:
+					case MAP_BLOCK_SNAKE_UP:
+						text = SPRITE_BODY_VERTICAL;
+						break;
+					case MAP_BLOCK_SNAKE_LEFT:
+					case MAP_BLOCK_SNAKE_RIGHT:
+						text = SPRITE_BODY_HORIZONTAL;
+						break;
+					default:
+						break;
+				}
+			}
+			else
+			{
+				if ((prev == MAP_BLOCK_SNAKE_DOWN
+						&& cur == MAP_BLOCK_SNAKE_LEFT)
+						|| (prev == MAP_BLOCK_SNAKE_RIGHT
+							&& cur == MAP_BLOCK_SNAKE_UP))
+				{
+					text = SPRITE_BODY_DOWN_LEFT;
+				}
+				else if ((prev == MAP_BLOCK_SNAKE_UP
+							&& cur == MAP_BLOCK_SNAKE_LEFT)
+						|| (prev == MAP_BLOCK_SNAKE_RIGHT
+							&& cur == MAP_BLOCK_SNAKE_DOWN))
+				{
+					text = SPRITE_BODY_UP_LEFT;
+				}
+				else if ((prev == MAP_BLOCK_SNAKE_DOWN
+							&& cur == MAP_BLOCK_SNAKE_RIGHT)
+						|| (prev == MAP_BLOCK_SNAKE_LEFT
+							&& cur == MAP_BLOCK_SNAKE_UP))
+				{
+					text = SPRITE_BODY_DOWN_RIGHT;
+				}
+				else if ((prev == MAP_BLOCK_SNAKE_UP
+							&& cur == MAP_BLOCK_SNAKE_RIGHT)
+						|| (prev == MAP_BLOCK_SNAKE_LEFT
+							&& cur == MAP_BLOCK_SNAKE_DOWN))
+				{
+					text = SPRITE_BODY_UP_RIGHT;
+				}
+			}
+		}
+
+		render_texture(ctx, text, VIEW_X(view, c), VIEW_Y(view, r), cz, cz);
+
+		prev = cur;
+	}
+}
+
+void render_map(struct sdl_context *ctx, struct map *map, int cz)
+{
+	int ww, wh;
+	struct view view;
+	get_window_size(ctx, &ww, &wh);
+	view_update(&view, map, ww, wh, cz, map->snakes[0].head_row,
+			map->snakes[0].head_col);
+
+	// Render background (space) and walls.
+	if (NULL != ctx->static_layer)
+	{
+		SDL_Rect src = {
+			.x = view.col_begin,
+			.y = view.row_begin,
+			.w = view.col_end - view.col_begin,
+			.h = view.row_end - view.row_begin
+		};
+
+		SDL_Rect dst = {
+			.x = VIEW_X(&view, view.col_begin),
+			.y = VIEW_Y(&view, view.row_begin),
+			.w = src.w * cz,
+			.h = src.h * cz
+		};
+
+		SDL_RenderCopy(ctx->renderer, ctx->static_layer, &src, &dst);
+	}
+	else
+	{
+		VIEW_FOR_EACH_BLOCK(&view, map, y, x, block)
+		{
+			render_rect(
+				ctx,
+				VIEW_X(&view, x),
+				VIEW_Y(&view, y),
+				cz,
+				cz,
+				static_color(block, y, x)
+			);
+		}
+	}
+
+	// Render snakes.
+	for (size_t i = 0; i < map->n_snakes; ++i)
+		render_snake(ctx, map, &map->snakes[i], &view, cz);
+
+	// Render food.
+	VIEW_FOR_EACH_BLOCK(&view, map, row, col, block)
+	{
+		if (block == MAP_BLOCK_FOOD)
+		{
+			render_texture(
+				ctx,
+				SPRITE_APPLE,
+				VIEW_X(&view, col),
+				VIEW_Y(&view, row),
+				cz,
+				cz
+			);
+		}
+	}
+}
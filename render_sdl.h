@@ -0,0 +1,83 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_render.h>
+#include <SDL2/SDL_mixer.h>
+#include <stdint.h>
+#include "map.h"
+#include "view.h"
+#include "assets.h"
+
+enum sprite
+{
+#define X(id, path) SPRITE_##id,
+	ASSETS_SPRITES(X)
+#undef X
+	SPRITE_WHITE,
+	SPRITE_COUNT
+};
+
+enum sound
+{
+#define X(id, path) SOUND_##id,
+	ASSETS_SOUNDS(X)
+#undef X
+	SOUND_COUNT
+};
+
+// What render_map draws with. The renderer draws either on the window
+// or, with no window, on an offscreen surface.
+struct sdl_context
+{
+	SDL_Window *win;
+	SDL_Renderer *renderer;
+	// Every sprite packed in one texture, with the texture coordinates of
+	// the top left and bottom right corners of each one.
+	SDL_Texture *atlas;
+	SDL_FPoint uv[SPRITE_COUNT][2];
+	// Quads drawn since begin_draw, submitted together by end_draw.
+	SDL_Vertex *vertices;
+	int *indices;
+	int n_quads, max_quads;
+	// The blocks that never change, one texel per block.
+	SDL_Texture *static_layer;
+	Mix_Chunk *sounds[SOUND_COUNT];
+	// Samples converted at startup when the mixer didn't open the device
+	// in the format the sounds are stored in.
+	Uint8 *converted[SOUND_COUNT];
+};
+
+void fail(const char *msg);
+void build_atlas(struct sdl_context *ctx);
+void push_quad(struct sdl_context *ctx, enum sprite sprite, int x, int y,
+		int w, int h, uint32_t color);
+void render_texture(struct sdl_context *ctx, int sprite, int x, int y,
+		int w, int h);
+void render_rect(struct sdl_context *ctx, int x, int y, int w, int h,
+		uint32_t color);
+void begin_draw(struct sdl_context *ctx);
+void end_draw(struct sdl_context *ctx);
+void get_window_size(struct sdl_context *ctx, int *ww, int *wh);
+uint32_t static_color(enum map_block_type block, size_t row, size_t col);
+void build_static_layer(struct sdl_context *ctx, const struct map *map);
+void render_snake(struct sdl_context *ctx, const struct map *map,
+		const struct map_snake *snake, const struct view *view, int cz);
+void render_map(struct sdl_context *ctx, struct map *map, int cz);
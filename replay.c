@@ -0,0 +1,253 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "map.h"
+#include "replay.h"
+
+static int __replay_write_varint(FILE *fp, uint64_t value)
+{
+	do
+	{
+		if (putc((value & 0x7f) | (value > 0x7f ? 0x80 : 0), fp) == EOF)
+			return -1;
+		value >>= 7;
+	} while (value != 0);
+
+	return 0;
+}
+
+static int __replay_read_varint(FILE *fp, uint64_t *value)
+{
+	int byte;
+
+	*value = 0;
+
+	for (unsigned int shift = 0; shift < 64; shift += 7)
+	{
+		if ((byte = getc(fp)) == EOF)
+			return -1;
+		*value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return 0;
+	}
+
+	return -1;
+}
+
+int replay_begin(struct replay *replay, FILE *fp, const struct map *map)
+{
+	char *map_str;
+	size_t map_str_len;
+	int ret;
+
+	replay->fp = fp;
+	replay->last_tick = map->tick;
+
+	if (NULL == fp)
+		return 0;
+
+	if (NULL == (map_str = malloc(MAP_STR_SIZE(map))))
+		return -1;
+
+	map_stringify(map, MAP_STR_SIZE(map), map_str);
+	map_str_len = strlen(map_str);
+
+	ret = fputs(REPLAY_MAGIC, fp) == EOF ||
+		__replay_write_varint(fp, map->rng.state) < 0 ||
+		__replay_write_varint(fp, map->rng.inc) < 0 ||
+		__replay_write_varint(fp, map_str_len) < 0 ||
+		fwrite(map_str, 1, map_str_len, fp) != map_str_len ? -1 : 0;
+
+	free(map_str);
+
+	return ret;
+}
+
+// Records the turn applied by the last call to map_advance, if any. The
+// turn is stored at the tick it was applied in, before the advance.
+int replay_turn(struct replay *replay, const struct map *map)
+{
+	uint64_t delta = map->tick - 1 - replay->last_tick;
+
+	if (NULL == replay->fp || map->snakes[0].turn.dir == MAP_BLOCK_INVALID)
+		return 0;
+
+	replay->last_tick = map->tick - 1;
+
+	return __replay_write_varint(replay->fp,
+			delta << 3 | (map->snakes[0].turn.dir - MAP_BLOCK_SNAKE_UP));
+}
+
+int replay_end(struct replay *replay, const struct map *map)
+{
+	uint64_t delta = map->tick - replay->last_tick;
+
+	if (NULL == replay->fp)
+		return 0;
+
+	if (__replay_write_varint(replay->fp, delta << 3 | REPLAY_CODE_END) < 0 ||
+			__replay_write_varint(replay->fp, map->snakes[0].body_len) < 0 ||
+			__replay_write_varint(replay->fp, map_hash(map)) < 0)
+		return -1;
+
+	return fflush(replay->fp) == EOF ? -1 : 0;
+}
+
+// Reads the next game of a replay, returns 0 at the end of the file.
+int replay_read_game(FILE *fp, struct replay_game *game)
+{
+	char magic[sizeof(REPLAY_MAGIC) - 1];
+	uint64_t map_str_len, record, tick, hash;
+	struct replay_turn *turns;
+	size_t turns_cap;
+	char *map_str;
+
+	memset(game, 0, sizeof(*game));
+
+	if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic))
+		return feof(fp) ? 0 : -1;
+
+	if (memcmp(magic, REPLAY_MAGIC, sizeof(magic)) != 0 ||
+			__replay_read_varint(fp, &game->rng.state) < 0 ||
+			__replay_read_varint(fp, &game->rng.inc) < 0 ||
+			__replay_read_varint(fp, &map_str_len) < 0 ||
+			NULL == (map_str = malloc(map_str_len + 1)))
+		return -1;
+
+	if (fread(map_str, 1, map_str_len, fp) != map_str_len)
+	{
+		free(map_str);
+		return -1;
+	}
+
+	map_str[map_str_len] = '\0';
+	game->map = map_parse(map_str);
+	free(map_str);
+
+	if (NULL == game->map)
+		return -1;
+
+	for (tick = 0, turns_cap = 0; ; )
+	{
+		if (__replay_read_varint(fp, &record) < 0)
+			goto fail;
+
+		tick += record >> 3;
+
+		if ((record & 7) == REPLAY_CODE_END)
+			break;
+
+		if ((record & 7) > REPLAY_CODE_END)
+			goto fail;
+
+		if (game->n_turns == turns_cap)
+		{
+			turns_cap = turns_cap ? turns_cap * 2 : 64;
+			turns = realloc(game->turns, turns_cap * sizeof(*turns));
+			if (NULL == turns)
+				goto fail;
+			game->turns = turns;
+		}
+
+		game->turns[game->n_turns].tick = tick;
+		game->turns[game->n_turns].dir = MAP_BLOCK_SNAKE_UP + (record & 7);
+		game->n_turns += 1;
+	}
+
+	if (__replay_read_varint(fp, &game->end_len) < 0 ||
+			__replay_read_varint(fp, &hash) < 0)
+		goto fail;
+
+	game->end_tick = tick;
+	game->end_hash = hash;
+
+	return 1;
+
+fail:
+	replay_free_game(game);
+	return -1;
+}
+
+void replay_free_game(struct replay_game *game)
+{
+	map_destroy(game->map);
+	free(game->turns);
+	memset(game, 0, sizeof(*game));
+}
+
+// Takes a map of the same size as the game to the state it started in.
+int replay_start(const struct replay_game *game, struct map *map)
+{
+	if (map_copy(game->map, map) < 0)
+		return -1;
+
+	map->rng = game->rng;
+
+	return 0;
+}
+
+// Plays one tick of a game on a map set up by replay_start, applying the
+// turns recorded for it. turn is the index of the next turn of the game,
+// and starts at 0. Food is left to the caller, as after map_advance.
+// Returns 0, without playing, once the game is over.
+int replay_step(const struct replay_game *game, struct map *map,
+		size_t *turn, enum map_snake_state *state)
+{
+	if (map->tick >= game->end_tick ||
+			map->snakes[0].state == MAP_SNAKE_DEAD)
+		return 0;
+
+	for (; *turn < game->n_turns && game->turns[*turn].tick == map->tick;
+			++*turn)
+		map_set_snake_direction(map, game->turns[*turn].dir);
+
+	if (map_advance(map, state) < 0)
+		return -1;
+
+	return 1;
+}
+
+// Tells whether a game played on a map ended the way it was recorded.
+int replay_check(const struct replay_game *game, const struct map *map)
+{
+	return map->tick == game->end_tick &&
+		map->snakes[0].body_len == game->end_len &&
+		map_hash(map) == game->end_hash;
+}
+
+// Plays a game on a map of the same size, returns -1 if the game does not
+// end the way it was recorded.
+int replay_run(const struct replay_game *game, struct map *map)
+{
+	enum map_snake_state state;
+	size_t turn = 0;
+	int ret;
+
+	if (replay_start(game, map) < 0)
+		return -1;
+
+	while ((ret = replay_step(game, map, &turn, &state)) > 0)
+		if (state == MAP_SNAKE_EATING)
+			map_spawn_food(map);
+
+	return ret == 0 && replay_check(game, map) ? 0 : -1;
+}
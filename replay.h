@@ -0,0 +1,68 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include "map.h"
+
+// A replay file is a sequence of games. Each game starts with the magic
+// "VBR1", the state of the food generator and the initial map as text,
+// followed by one varint per turn holding (tick delta << 3 | code), where
+// code is the direction minus MAP_BLOCK_SNAKE_UP or REPLAY_CODE_END. The
+// end record is followed by the length of the snake and the map_hash of
+// the grid at that point, so playback can be checked.
+
+#define REPLAY_MAGIC "VBR1"
+#define REPLAY_CODE_END 4
+
+// Recording state, every call is a no-op when fp is NULL.
+struct replay
+{
+	FILE *fp;
+	uint64_t last_tick;
+};
+
+struct replay_turn
+{
+	uint64_t tick;
+	enum map_block_type dir;
+};
+
+struct replay_game
+{
+	struct map *map;
+	struct map_rng rng;
+	struct replay_turn *turns;
+	size_t n_turns;
+	uint64_t end_tick;
+	uint64_t end_len;
+	uint32_t end_hash;
+};
+
+int replay_begin(struct replay *replay, FILE *fp, const struct map *map);
+int replay_turn(struct replay *replay, const struct map *map);
+int replay_end(struct replay *replay, const struct map *map);
+int replay_read_game(FILE *fp, struct replay_game *game);
+void replay_free_game(struct replay_game *game);
+int replay_start(const struct replay_game *game, struct map *map);
+int replay_step(const struct replay_game *game, struct map *map,
+		size_t *turn, enum map_snake_state *state);
+int replay_check(const struct replay_game *game, const struct map *map);
+int replay_run(const struct replay_game *game, struct map *map);
@@ -17,39 +17,56 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
 
-static int __is_regular_file(const char *path)
+static int __regular_file_size(const char *path, size_t *size)
 {
 	struct stat sb;
 
-	if (stat(path, &sb) < 0)
-		return 0;
+	if (stat(path, &sb) < 0 || !S_ISREG(sb.st_mode))
+		return -1;
+
+	*size = sb.st_size;
 
-	return !!S_ISREG(sb.st_mode);
+	return 0;
 }
 
-int dump_file_cts(const char *path, size_t max_size, char *out)
+// Returns the NUL terminated contents of a file, to be freed by the caller.
+char *dump_file_cts(const char *path)
 {
 	FILE *fp;
+	char *out;
+	size_t size;
 	unsigned long n_bytes_read;
 
-	if (!__is_regular_file(path))
-		return -1;
+	if (__regular_file_size(path, &size) < 0)
+		return NULL;
 
 	fp = fopen(path, "r");
 
 	if (NULL == fp)
-		return -1;
+		return NULL;
+
+	if (NULL == (out = malloc(size + 1)))
+	{
+		fclose(fp);
+		return NULL;
+	}
 
-	n_bytes_read = fread(out, 1, max_size - 1, fp);
+	n_bytes_read = fread(out, 1, size, fp);
 	if (n_bytes_read == 0 && !feof(fp))
-		return -1;
+	{
+		fclose(fp);
+		free(out);
+		return NULL;
+	}
 
+	fclose(fp);
 	out[n_bytes_read] = '\0';
 
-	return 0;
+	return out;
 }
@@ -0,0 +1,65 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#include <stddef.h>
+#include "map.h"
+#include "view.h"
+
+// Computes the blocks in [0, n_blocks) that fall, at least partly, inside
+// [0, length) when the first one starts at offset.
+static void __view_clip(long offset, long length, int block_size,
+		size_t n_blocks, size_t *begin, size_t *end)
+{
+	long first, last;
+
+	first = offset < 0 ? -offset / block_size : 0;
+	last = length > offset ?
+		(length - offset + block_size - 1) / block_size : 0;
+
+	if (last > (long)(n_blocks))
+		last = n_blocks;
+
+	if (first > last)
+		first = last;
+
+	*begin = first;
+	*end = last;
+}
+
+// Places the block (center_row, center_col) in the middle of the screen
+// and computes which blocks are visible.
+void view_update(struct view *view, const struct map *map, long width,
+		long height, int block_size, size_t center_row, size_t center_col)
+{
+	view->width = width;
+	view->height = height;
+	view->block_size = block_size;
+	view->x = (width - block_size) / 2 - (long)(center_col) * block_size;
+	view->y = (height - block_size) / 2 - (long)(center_row) * block_size;
+
+	__view_clip(view->x, width, block_size, map->n_cols,
+			&view->col_begin, &view->col_end);
+	__view_clip(view->y, height, block_size, map->n_rows,
+			&view->row_begin, &view->row_end);
+}
+
+int view_contains(const struct view *view, size_t row, size_t col)
+{
+	return row >= view->row_begin && row < view->row_end &&
+		col >= view->col_begin && col < view->col_end;
+}
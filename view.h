@@ -0,0 +1,53 @@
+/*
+	Copyright (C) 2023-2025 <alpheratz99@protonmail.com>
+
+	This program is free software; you can redistribute it and/or modify it
+	under the terms of the GNU General Public License version 2 as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful, but WITHOUT
+	ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+	more details.
+
+	You should have received a copy of the GNU General Public License along with
+	this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+	Place, Suite 330, Boston, MA 02111-1307 USA
+
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include "map.h"
+
+// Screen position of the top left corner of a block.
+#define VIEW_X(v, col) ((v)->x + (long)(col) * (v)->block_size)
+#define VIEW_Y(v, row) ((v)->y + (long)(row) * (v)->block_size)
+
+// Iterates only the blocks of the map that are visible in the view.
+#define VIEW_FOR_EACH_BLOCK(v, m, row, col, block) \
+	for (size_t row = (v)->row_begin, col = (v)->col_begin; \
+			row < (v)->row_end; ++row, col = (v)->col_begin) \
+		for ( \
+			enum map_block_type block; \
+			col < (v)->col_end && ((block = MAP_BLOCK_AT(m, row, col)), 1); \
+			++col \
+		) \
+
+// Part of a map shown on a screen of width by height units, pixels or
+// terminal cells, where every block is block_size units wide.
+struct view
+{
+	long width, height;
+	int block_size;
+	// Screen position of the top left corner of the map.
+	long x, y;
+	// Visible blocks, as half open ranges.
+	size_t row_begin, row_end;
+	size_t col_begin, col_end;
+};
+
+void view_update(struct view *view, const struct map *map, long width,
+		long height, int block_size, size_t center_row, size_t center_col);
+int view_contains(const struct view *view, size_t row, size_t col);